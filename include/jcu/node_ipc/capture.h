@@ -0,0 +1,90 @@
+/**
+ * @file	capture.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_CAPTURE_H__
+#define __JCU_NODE_IPC_CAPTURE_H__
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+
+namespace jcu {
+    namespace node_ipc {
+
+        class Client;
+
+        /*
+         * Capture file layout (little endian):
+         *   header: "JNIC" u16 version, u16 reserved, u64 start time (ns since the unix epoch)
+         *   record: u8 direction, u64 timestamp (ns since the start), u32 length, bytes
+         * Inbound records are raw transport reads, outbound records are whole frames.
+         */
+
+        enum CaptureDirection {
+            CAPTURE_INBOUND = 0,
+            CAPTURE_OUTBOUND = 1,
+        };
+
+        struct CaptureRecord {
+            CaptureDirection direction;
+            uint64_t timestamp_ns;
+            const char *data;
+            size_t length;
+        };
+
+        /**
+         * Read-only, memory mapped capture file
+         */
+        class CaptureFile {
+        public:
+            virtual ~CaptureFile() {}
+
+            /**
+             * @param path
+             * @return nullptr if the file cannot be mapped or is not a capture
+             */
+            static std::unique_ptr<CaptureFile> open(const std::string& path);
+
+            virtual uint64_t startTime() const = 0;
+
+            /**
+             * Read the record at offset and advance offset past it.
+             * Start with offset 0.
+             * @return False at the end of the file or on a truncated record
+             */
+            virtual bool next(size_t& offset, CaptureRecord& record) const = 0;
+        };
+
+        enum ReplayPacing {
+            REPLAY_FULL_SPEED = 0,
+            REPLAY_RECORDED,
+        };
+
+        struct ReplayStats {
+            uint64_t records;
+            uint64_t bytes;
+            double seconds;
+        };
+
+        /**
+         * Drive the client's frame decoder and handler dispatch with the inbound
+         * records of a capture, without a socket. Runs on the calling thread, which
+         * takes the role of the loop thread. Returns once offloaded handlers have
+         * finished, so seconds covers them.
+         * @param file
+         * @param client
+         * @param pacing REPLAY_RECORDED sleeps to reproduce the recorded arrival times
+         * @return ReplayStats
+         */
+        ReplayStats replayCapture(const CaptureFile& file, Client& client, ReplayPacing pacing = REPLAY_FULL_SPEED);
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_CAPTURE_H__
@@ -0,0 +1,149 @@
+/**
+ * @file	channel.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_CHANNEL_H__
+#define __JCU_NODE_IPC_CHANNEL_H__
+
+#include "client.h"
+#include "message_traits.h"
+
+#include <string>
+#include <memory>
+#include <functional>
+
+namespace jcu {
+    namespace node_ipc {
+
+        template<typename T>
+        class TypedMessageHandler : public MessageHandler {
+        public:
+            typedef std::function<void(T&)> OnTypedMessage_t;
+
+        private:
+            OnTypedMessage_t func_;
+
+        public:
+            TypedMessageHandler(const OnTypedMessage_t& func) : func_(func) {}
+
+            void invoke(IncomingMessage& message) override {
+                T value;
+                JsonReader reader(message.dataBegin(), message.dataEnd());
+                if(!MessageTraits<T>::read(reader, value) || !reader.ok()) {
+                    message.decodeFailed("cannot decode data of " + message.type());
+                    return;
+                }
+                func_(value);
+            }
+        };
+
+        template<typename T>
+        class TypedConflationKey : public ConflationKeyExtractor {
+        public:
+            typedef std::function<std::string(const T&)> KeyFunc_t;
+
+        private:
+            KeyFunc_t func_;
+
+        public:
+            TypedConflationKey(const KeyFunc_t& func) : func_(func) {}
+
+            const std::type_info& valueType() const override {
+                return typeid(T);
+            }
+
+            std::string key(const T& value) const {
+                return func_(value);
+            }
+        };
+
+        /**
+         * Typed view of one message type.
+         * Values are serialized by MessageTraits<T> straight into the wire frame and
+         * decoded from the received frame text without an intermediate Json::Value.
+         */
+        template<typename T>
+        class Channel {
+        public:
+            typedef typename TypedMessageHandler<T>::OnTypedMessage_t OnTypedMessage_t;
+            typedef typename TypedConflationKey<T>::KeyFunc_t ConflationKeyFunc_t;
+
+        private:
+            Client *client_;
+            std::string type_;
+
+            // {"type":"<type>","data":
+            std::string prefix_;
+
+        public:
+            Channel(Client *client, const std::string& type) : client_(client), type_(type) {
+                prefix_ = "{\"type\":";
+                JsonWriter::escapeString(prefix_, type.data(), type.length());
+                prefix_.append(",\"data\":");
+            }
+
+            Client *client() const {
+                return client_;
+            }
+
+            const std::string& type() const {
+                return type_;
+            }
+
+            /**
+             * Latest-value policy for this type, see Client::setConflation.
+             * The key is taken from the value before it is serialized. The policy belongs to
+             * the client, so it applies to every Channel<T> of this type.
+             * @param key_func one key per type when empty
+             */
+            void setConflation(ConflationKeyFunc_t key_func = nullptr) {
+                if(key_func) {
+                    client_->setTypedConflation(type_, std::make_shared<TypedConflationKey<T>>(key_func));
+                }else{
+                    client_->setConflation(type_);
+                }
+            }
+
+            void emit(const T& value) {
+                const ConflationKeyExtractor *extractor = client_->conflationKeyExtractor(type_);
+                bool keyed = extractor && extractor->valueType() == typeid(T);
+                std::string key;
+                if(keyed) {
+                    key = static_cast<const TypedConflationKey<T> *>(extractor)->key(value);
+                }
+
+                JsonWriter writer(prefix_.length() + 128);
+                writer.raw(prefix_.data(), prefix_.length());
+                MessageTraits<T>::write(writer, value);
+                writer.put('}');
+                writer.put(0x0c);
+
+                size_t length = 0;
+                std::unique_ptr<char[]> frame = writer.release(length);
+                if(keyed) {
+                    client_->emitFrame(type_, key, std::move(frame), length);
+                }else{
+                    client_->emitFrame(type_, std::move(frame), length);
+                }
+            }
+
+            void onMessage(const OnTypedMessage_t& on_message, const MessageDispatchOptions& options = MessageDispatchOptions()) {
+                std::unique_ptr<MessageHandler> handler(new TypedMessageHandler<T>(on_message));
+                client_->addMessageHandler(type_, std::move(handler), options);
+            }
+        };
+
+        template<typename T>
+        Channel<T> Client::channel(const std::string& type) {
+            return Channel<T>(this, type);
+        }
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_CHANNEL_H__
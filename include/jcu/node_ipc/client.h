@@ -11,10 +11,12 @@
 #define __JCU_NODE_IPC_CLIENT_H__
 
 #include "instance.h"
+#include "waiter.h"
 
 #include <memory>
 #include <functional>
 #include <map>
+#include <typeinfo>
 
 #include <jcu/transport/error.h>
 
@@ -24,6 +26,40 @@ namespace jcu {
         class IpcConfig;
         class IpcSession;
 
+        template<typename T>
+        class Channel;
+
+        /**
+         * Conflation key function of a typed channel, registered per message type with
+         * Client::setTypedConflation. See TypedConflationKey<T>.
+         */
+        class ConflationKeyExtractor {
+        public:
+            virtual ~ConflationKeyExtractor() {}
+            virtual const std::type_info& valueType() const = 0;
+        };
+
+        struct HeartbeatStats {
+            uint64_t sent;
+            uint64_t received;
+
+            /**
+             * pings currently unanswered
+             */
+            uint32_t outstanding;
+
+            /**
+             * round-trip times over the rolling window, in milliseconds
+             */
+            size_t samples;
+            double last_ms;
+            double min_ms;
+            double mean_ms;
+            double p50_ms;
+            double p99_ms;
+            double max_ms;
+        };
+
         class Client : public Instance {
         public:
             typedef std::function<void()> ConnectCallback_t;
@@ -50,14 +86,132 @@ namespace jcu {
 
             virtual void close() = 0;
 
+            virtual bool isConnected() const = 0;
+
+            /**
+             * Heartbeat round-trip statistics. Call on the loop thread.
+             * @return HeartbeatStats
+             */
+            virtual HeartbeatStats heartbeatStats() const = 0;
+
             virtual void onError(ErrorCallback_t on_error) = 0;
 
             virtual void emit(const std::string& type, const Json::Value& data) = 0;
 
+            /**
+             * Write a fully encoded frame, including the trailing delimiter
+             * @param frame
+             * @param length
+             */
+            virtual void emitFrame(std::unique_ptr<char[]> frame, size_t length) = 0;
+
+            /**
+             * Write a fully encoded frame of msg_type, subject to its conflation policy
+             * @param msg_type
+             * @param frame
+             * @param length
+             */
+            virtual void emitFrame(const std::string& msg_type, std::unique_ptr<char[]> frame, size_t length) = 0;
+
+            /**
+             * Write a fully encoded frame of msg_type with the conflation key of its data,
+             * computed by the caller before encoding
+             * @param msg_type
+             * @param conflation_key used when msg_type has a conflation policy
+             * @param frame
+             * @param length
+             */
+            virtual void emitFrame(const std::string& msg_type, const std::string& conflation_key, std::unique_ptr<char[]> frame, size_t length) = 0;
+
+            /**
+             * Latest-value policy for msg_type: while the link is backpressured or not
+             * connected, only the newest pending message per key is kept and it is sent
+             * once the link drains. Conflated messages may overtake other pending messages.
+             * Configure before emitting.
+             * @param msg_type
+             * @param key_func conflation key derived from the data of emit(). one key per type
+             *                 when empty. a keyed policy never conflates frames that come
+             *                 without a key (emitFrame): they are sent like any other message.
+             */
+            virtual void setConflation(const std::string& msg_type, ConflationKeyFunc_t key_func = nullptr) = 0;
+
+            /**
+             * Latest-value policy for msg_type keyed by the typed value, as set by
+             * Channel<T>::setConflation. Applies to every Channel<T> of msg_type; emit() of
+             * Json values and channels of another T are sent without conflation.
+             * @param msg_type
+             * @param key_extractor
+             */
+            virtual void setTypedConflation(const std::string& msg_type, std::shared_ptr<ConflationKeyExtractor> key_extractor) = 0;
+
+            /**
+             * @param msg_type
+             * @return key function registered with setTypedConflation, nullptr if none
+             */
+            virtual const ConflationKeyExtractor *conflationKeyExtractor(const std::string& msg_type) const = 0;
+
+            /**
+             * Typed channel of a message type. Requires a MessageTraits<T> specialization.
+             * @param type message type
+             * @return Channel<T>
+             */
+            template<typename T>
+            Channel<T> channel(const std::string& type);
+
+            /**
+             * Complete the waiter on the next successful connection.
+             * Must be called on the loop thread.
+             * @param waiter
+             */
+            virtual void waitConnected(Waiter *waiter) = 0;
+
+            /**
+             * Complete the waiter with the next message of msg_type.
+             * Must be called on the loop thread.
+             * @param msg_type
+             * @param waiter
+             */
+            virtual void waitMessage(const std::string& msg_type, Waiter *waiter) = 0;
+
+            /**
+             * Record inbound reads and outbound frames to a capture file (see capture.h).
+             * Call on the loop thread.
+             * @param path created or truncated
+             * @return false if the file cannot be created
+             */
+            virtual bool startCapture(const std::string& path) = 0;
+            virtual void stopCapture() = 0;
+
+            /**
+             * Process bytes as if they were read from the transport.
+             * Call on the loop thread, or on the replaying thread when not connected.
+             * @param data
+             * @param length
+             */
+            virtual void feed(const char *data, size_t length) = 0;
+
+            /**
+             * Block until every offloaded handler queued so far has returned.
+             * Call from the same thread as feed(), never from a handler.
+             */
+            virtual void waitIdle() = 0;
+
+            /**
+             * Unlink a pending waiter without completing it
+             * @param waiter
+             */
+            void cancelWait(Waiter *waiter) {
+                if(waiter->wait_list_) {
+                    waiter->wait_list_->remove(waiter);
+                }
+            }
+
             static std::shared_ptr<Client> create();
         };
 
     }
 }
 
+#include "channel.h"
+
 #endif // __JCU_NODE_IPC_CLIENT_H__
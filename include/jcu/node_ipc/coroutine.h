@@ -0,0 +1,224 @@
+/**
+ * @file	coroutine.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_COROUTINE_H__
+#define __JCU_NODE_IPC_COROUTINE_H__
+
+#include "client.h"
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L) && __has_include(<coroutine>)
+#define JCU_NODE_IPC_HAS_COROUTINE 1
+
+#include <coroutine>
+#include <optional>
+#include <string>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * Base of the awaitables below. The awaiter itself is the waiter linked into
+         * the client, so it lives in the coroutine frame and an await does not allocate.
+         * Awaiting must happen on the loop thread; the coroutine is resumed there.
+         * A coroutine still suspended when the client is destroyed is not resumed.
+         */
+        class AwaiterBase : public Waiter {
+        protected:
+            Client *client_;
+            std::coroutine_handle<> handle_;
+
+        public:
+            explicit AwaiterBase(Client *client) : client_(client) {}
+            AwaiterBase(const AwaiterBase&) = delete;
+            AwaiterBase& operator=(const AwaiterBase&) = delete;
+
+            ~AwaiterBase() override {
+                // Coroutine destroyed while suspended; the client may already be gone
+                if(wait_list_) {
+                    wait_list_->remove(this);
+                }
+            }
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+        };
+
+        class ConnectAwaiter : public AwaiterBase {
+        private:
+            std::string id_;
+            std::string host_;
+            int port_;
+            bool connected_;
+
+        public:
+            ConnectAwaiter(Client *client, const std::string& id, const std::string& host, int port)
+                : AwaiterBase(client), id_(id), host_(host), port_(port), connected_(false) {}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                handle_ = handle;
+                client_->waitConnected(this);
+                client_->connectToNet(id_, host_, port_);
+            }
+
+            /**
+             * @return False if the client was closed or gave up before connecting
+             */
+            bool await_resume() const noexcept {
+                return connected_;
+            }
+
+            void onWaitComplete(IncomingMessage *message) override {
+                connected_ = client_->isConnected();
+                handle_.resume();
+            }
+        };
+
+        class MessageAwaiter : public AwaiterBase {
+        protected:
+            const std::string& type_;
+            std::optional<Json::Value> result_;
+
+        public:
+            MessageAwaiter(Client *client, const std::string& type) : AwaiterBase(client), type_(type) {}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                handle_ = handle;
+                client_->waitMessage(type_, this);
+            }
+
+            /**
+             * @return data of the message, empty if the client was closed or the data is not valid JSON
+             */
+            std::optional<Json::Value> await_resume() noexcept {
+                return std::move(result_);
+            }
+
+            void onWaitComplete(IncomingMessage *message) override {
+                if(message && message->parseJson()) {
+                    result_.emplace(message->json());
+                }
+                handle_.resume();
+            }
+        };
+
+        class RequestAwaiter : public MessageAwaiter {
+        private:
+            const std::string& request_type_;
+            const Json::Value& request_data_;
+
+        public:
+            RequestAwaiter(Client *client, const std::string& request_type, const Json::Value& request_data, const std::string& reply_type)
+                : MessageAwaiter(client, reply_type), request_type_(request_type), request_data_(request_data) {}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                // Register before sending so a fast reply cannot be missed
+                MessageAwaiter::await_suspend(handle);
+                client_->emit(request_type_, request_data_);
+            }
+        };
+
+        template<typename T>
+        class ChannelAwaiter : public AwaiterBase {
+        protected:
+            const std::string& type_;
+            std::optional<T> result_;
+
+        public:
+            ChannelAwaiter(Client *client, const std::string& type) : AwaiterBase(client), type_(type) {}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                handle_ = handle;
+                client_->waitMessage(type_, this);
+            }
+
+            /**
+             * @return decoded message, empty if the client was closed or decoding failed
+             */
+            std::optional<T> await_resume() noexcept {
+                return std::move(result_);
+            }
+
+            void onWaitComplete(IncomingMessage *message) override {
+                if(message) {
+                    JsonReader reader(message->dataBegin(), message->dataEnd());
+                    T value;
+                    if(MessageTraits<T>::read(reader, value) && reader.ok()) {
+                        result_.emplace(std::move(value));
+                    }else{
+                        message->decodeFailed("cannot decode data of " + message->type());
+                    }
+                }
+                handle_.resume();
+            }
+        };
+
+        template<typename T, typename R>
+        class ChannelRequestAwaiter : public ChannelAwaiter<R> {
+        private:
+            Channel<T>& request_channel_;
+            const T& request_value_;
+
+        public:
+            ChannelRequestAwaiter(Client *client, Channel<T>& request_channel, const T& request_value, const std::string& reply_type)
+                : ChannelAwaiter<R>(client, reply_type), request_channel_(request_channel), request_value_(request_value) {}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                ChannelAwaiter<R>::await_suspend(handle);
+                request_channel_.emit(request_value_);
+            }
+        };
+
+        /**
+         * co_await connect(client, id): connect and resume once connected
+         */
+        inline ConnectAwaiter connect(Client& client, const std::string& id, const std::string& host = "", int port = 0) {
+            return ConnectAwaiter(&client, id, host, port);
+        }
+
+        /**
+         * co_await nextMessage(client, type): resume with the data of the next message of type.
+         * The arguments must outlive the co_await expression.
+         */
+        inline MessageAwaiter nextMessage(Client& client, const std::string& type) {
+            return MessageAwaiter(&client, type);
+        }
+
+        /**
+         * co_await request(client, type, data, reply_type): emit a message and resume with the data
+         * of the next message of reply_type. The protocol has no correlation id, so concurrent
+         * requests with the same reply_type all receive the first reply.
+         * The arguments must outlive the co_await expression.
+         */
+        inline RequestAwaiter request(Client& client, const std::string& type, const Json::Value& data, const std::string& reply_type) {
+            return RequestAwaiter(&client, type, data, reply_type);
+        }
+
+        /**
+         * co_await nextMessage(channel): resume with the next decoded message of the channel
+         */
+        template<typename T>
+        ChannelAwaiter<T> nextMessage(const Channel<T>& channel) {
+            return ChannelAwaiter<T>(channel.client(), channel.type());
+        }
+
+        /**
+         * co_await request(channel, value, reply_channel): typed variant of request()
+         */
+        template<typename T, typename R>
+        ChannelRequestAwaiter<T, R> request(Channel<T>& channel, const T& value, const Channel<R>& reply_channel) {
+            return ChannelRequestAwaiter<T, R>(channel.client(), channel, value, reply_channel.type());
+        }
+
+    }
+}
+
+#endif // __cpp_impl_coroutine
+
+#endif // __JCU_NODE_IPC_COROUTINE_H__
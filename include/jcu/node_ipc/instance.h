@@ -13,6 +13,7 @@
 #include "session_attr.h"
 
 #include <string>
+#include <memory>
 #include <functional>
 
 #include <json/value.h>
@@ -22,9 +23,73 @@ namespace jcu {
 
         typedef std::function<void(Json::Value&)> OnMessage_t;
         typedef std::function<void(Json::Value&, const std::string& type)> OnMessageWithType_t;
+        typedef std::function<std::string(const Json::Value&, const std::string& type)> OrderKeyFunc_t;
+        typedef std::function<std::string(const Json::Value&, const std::string& type)> ConflationKeyFunc_t;
+
+        struct MessageDispatchOptions {
+            /**
+             * invoke the handler on the client's worker pool instead of the loop thread
+             */
+            bool offload;
+
+            /**
+             * offloaded messages with the same key are handled in arrival order.
+             * the message type is used when empty.
+             */
+            OrderKeyFunc_t order_key;
+
+            /**
+             * for offloaded handlers: a message still waiting for a worker is replaced by a
+             * newer one with the same key, so only the latest state is handled.
+             */
+            bool conflate;
+
+            MessageDispatchOptions() : offload(false), conflate(false) {}
+        };
 
         class IpcConfig;
 
+        /**
+         * A received message. The "data" member is available as raw JSON text and,
+         * on demand, as a parsed Json::Value.
+         */
+        class IncomingMessage {
+        public:
+            virtual ~IncomingMessage() {}
+
+            virtual const std::string& type() const = 0;
+
+            /**
+             * Raw JSON text of the data member
+             */
+            virtual const char *dataBegin() const = 0;
+            virtual const char *dataEnd() const = 0;
+
+            /**
+             * Parse the data member if not done yet. A failure is reported to the error callback.
+             * @return False if the data is not valid JSON
+             */
+            virtual bool parseJson() = 0;
+
+            /**
+             * Data member parsed on first use, null if parseJson() failed
+             * @return Json::Value reference
+             */
+            virtual Json::Value& json() = 0;
+
+            /**
+             * Report that the data could not be decoded to the error callback
+             * @param what
+             */
+            virtual void decodeFailed(const std::string& what) = 0;
+        };
+
+        class MessageHandler {
+        public:
+            virtual ~MessageHandler() {}
+            virtual void invoke(IncomingMessage& message) = 0;
+        };
+
         class Instance {
         public:
             /**
@@ -62,6 +127,16 @@ namespace jcu {
 
             virtual void onMessage(const std::string& msg_type, const OnMessage_t& on_message) = 0;
             virtual void onMessage(const std::string& msg_type, const OnMessageWithType_t& on_message) = 0;
+            virtual void onMessage(const std::string& msg_type, const OnMessage_t& on_message, const MessageDispatchOptions& options) = 0;
+            virtual void onMessage(const std::string& msg_type, const OnMessageWithType_t& on_message, const MessageDispatchOptions& options) = 0;
+
+            /**
+             * Register a handler that receives the undecoded message
+             * @param msg_type
+             * @param handler
+             * @param options
+             */
+            virtual void addMessageHandler(const std::string& msg_type, std::unique_ptr<MessageHandler> handler, const MessageDispatchOptions& options) = 0;
         };
 
     }
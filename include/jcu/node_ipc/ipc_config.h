@@ -29,6 +29,50 @@ namespace jcu {
             std::vector<char> private_data;
         };
 
+        struct IpcShmConfig {
+            /**
+             * try a shared memory ring created by a peer on the same host before the
+             * network socket. the socket is used when no ring is available.
+             * the peer must create a fresh ring with ShmRing::create() for every connection
+             * (see shm_ring.h); a stock node-ipc server never does, so leave this off for it.
+             * ignored when tls.engine is set: the ring carries plain frames, so a TLS
+             * configuration always connects through the socket.
+             */
+            bool enabled;
+
+            /**
+             * shared memory object name. "/jcu-node-ipc.<id>" when empty.
+             */
+            std::string name;
+
+            IpcShmConfig() : enabled(false) {}
+        };
+
+        struct IpcHeartbeatConfig {
+            /**
+             * time in milliseconds between pings. 0 disables sending them;
+             * pings from the peer are answered either way.
+             */
+            int interval;
+
+            /**
+             * the peer is declared dead and the client reconnects after this many
+             * consecutive pings without a pong. values below 1 count as 1.
+             * no pings are sent or counted while input is paused for busy workers
+             * (worker_queue_limit), since the pongs are not read then.
+             */
+            int max_missed;
+
+            /**
+             * message types of the heartbeat. a peer answers ping_type with pong_type,
+             * echoing the data.
+             */
+            std::string ping_type;
+            std::string pong_type;
+
+            IpcHeartbeatConfig() : interval(0), max_missed(3), ping_type("__ping"), pong_type("__pong") {}
+        };
+
         struct IpcConfig {
             std::shared_ptr<uvw::Loop> loop;
 
@@ -54,14 +98,41 @@ namespace jcu {
              */
             int retry;
 
+            /**
+             * number of threads of the worker pool used by offloaded message handlers.
+             * 0 means hardware concurrency.
+             */
+            int worker_threads;
+
+            /**
+             * maximum number of offloaded messages waiting for a worker.
+             * when reached, the client stops reading (the shm ring is left unconsumed, socket
+             * input is buffered undispatched) until the workers drain half of it. 0 means unbounded.
+             */
+            size_t worker_queue_limit;
+
+            /**
+             * maximum bytes of socket input buffered while reading is paused for worker_queue_limit.
+             * when exceeded, the buffered input is discarded, on_error reports an InputBacklogOverflowError
+             * and the client reconnects (or closes if the handler clears flag_reconnect). 0 means unbounded.
+             */
+            size_t input_backlog_limit;
+
             NetworkTransportFactory_t network_transport_factory;
 
             IpcTlsConfig tls;
 
+            IpcShmConfig shm;
+
+            IpcHeartbeatConfig heartbeat;
+
             IpcConfig() {
                 this->networkHost = "localhost";
                 this->networkPort = 8000;
                 this->retry = 1500;
+                this->worker_threads = 0;
+                this->worker_queue_limit = 1024;
+                this->input_backlog_limit = 64 * 1024 * 1024;
             }
         };
 
@@ -0,0 +1,190 @@
+/**
+ * @file	json_stream.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_JSON_STREAM_H__
+#define __JCU_NODE_IPC_JSON_STREAM_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <memory>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * Append-only JSON writer that serializes straight into a wire frame buffer
+         */
+        class JsonWriter {
+        private:
+            std::unique_ptr<char[]> buf_;
+            size_t size_;
+            size_t capacity_;
+            bool need_comma_;
+
+            void grow(size_t required);
+            void separator() {
+                if(need_comma_)
+                    put(',');
+            }
+
+        public:
+            JsonWriter(size_t initial_capacity = 256);
+
+            void reserve(size_t capacity) {
+                if(capacity > capacity_)
+                    grow(capacity);
+            }
+            void put(char c) {
+                if(size_ == capacity_)
+                    grow(size_ + 1);
+                buf_[size_++] = c;
+            }
+            /**
+             * Append text as-is. The next value is written without a separator.
+             */
+            void raw(const char *data, size_t length);
+
+            void beginObject();
+            void endObject();
+            void beginArray();
+            void endArray();
+            void key(const char *name, size_t length);
+            void key(const std::string& name) {
+                key(name.data(), name.length());
+            }
+
+            void valueNull();
+            void value(bool v);
+            // One overload per fundamental integer type, so every intN_t alias resolves exactly
+            void value(short v) {
+                value((long long)v);
+            }
+            void value(unsigned short v) {
+                value((unsigned long long)v);
+            }
+            void value(int v) {
+                value((long long)v);
+            }
+            void value(unsigned int v) {
+                value((unsigned long long)v);
+            }
+            void value(long v) {
+                value((long long)v);
+            }
+            void value(unsigned long v) {
+                value((unsigned long long)v);
+            }
+            void value(long long v);
+            void value(unsigned long long v);
+            void value(double v);
+            void value(const char *str, size_t length);
+            void value(const char *str);
+            void value(const std::string& str) {
+                value(str.data(), str.length());
+            }
+
+            template<typename V>
+            void member(const char *name, const V& v) {
+                key(name, strlen(name));
+                value(v);
+            }
+
+            size_t size() const {
+                return size_;
+            }
+            const char *data() const {
+                return buf_.get();
+            }
+
+            /**
+             * Take the buffer. The writer is empty afterwards.
+             * @param length written length
+             */
+            std::unique_ptr<char[]> release(size_t& length);
+
+            static void escapeString(std::string& out, const char *str, size_t length);
+        };
+
+        /**
+         * Pull parser over a JSON text. All calls return false once an error occurred.
+         */
+        class JsonReader {
+        private:
+            const char *cur_;
+            const char *end_;
+            bool first_;
+            bool failed_;
+
+            void skipWhitespace();
+            bool expect(char c);
+            bool fail();
+            bool parseString(std::string* out);
+            bool parseNumber(const char **num_begin, const char **num_end, bool *integral);
+            bool readSigned(long long& v, long long min_value, long long max_value);
+            bool readUnsigned(unsigned long long& v, unsigned long long max_value);
+
+        public:
+            JsonReader(const char *begin, const char *end);
+
+            bool ok() const {
+                return !failed_;
+            }
+            const char *position() const {
+                return cur_;
+            }
+
+            bool beginObject();
+            /**
+             * @param key member name
+             * @return False when the end of the object was consumed
+             */
+            bool nextMember(std::string& key);
+            bool beginArray();
+            /**
+             * @return False when the end of the array was consumed
+             */
+            bool nextElement();
+
+            /**
+             * @return True if the next value is null (it is consumed)
+             */
+            bool readNull();
+
+            /**
+             * Integers fail on overflow and on non-integral numbers
+             */
+            bool read(bool& v);
+            bool read(short& v);
+            bool read(unsigned short& v);
+            bool read(int& v);
+            bool read(unsigned int& v);
+            bool read(long& v);
+            bool read(unsigned long& v);
+            bool read(long long& v);
+            bool read(unsigned long long& v);
+            bool read(double& v);
+            bool read(float& v);
+            bool read(std::string& v);
+
+            /**
+             * Skip a value. Strings, numbers, literals and bracket nesting are validated;
+             * separators inside containers are only checked by a full parse.
+             */
+            bool skip();
+            /**
+             * Skip a value and report its raw text range
+             */
+            bool skip(const char **value_begin, const char **value_end);
+        };
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_JSON_STREAM_H__
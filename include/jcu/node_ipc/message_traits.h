@@ -0,0 +1,95 @@
+/**
+ * @file	message_traits.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_MESSAGE_TRAITS_H__
+#define __JCU_NODE_IPC_MESSAGE_TRAITS_H__
+
+#include "json_stream.h"
+
+#include <string>
+#include <vector>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * Serializer descriptor of a typed channel message.
+         * Specialize it for each user type:
+         *
+         * template<> struct MessageTraits<Point> {
+         *     static void write(JsonWriter& writer, const Point& value) {
+         *         writer.beginObject();
+         *         writer.member("x", value.x);
+         *         writer.member("y", value.y);
+         *         writer.endObject();
+         *     }
+         *     static bool read(JsonReader& reader, Point& value) {
+         *         std::string key;
+         *         if(!reader.beginObject())
+         *             return false;
+         *         while(reader.nextMember(key)) {
+         *             if(key == "x") reader.read(value.x);
+         *             else if(key == "y") reader.read(value.y);
+         *             else reader.skip();
+         *         }
+         *         return reader.ok();
+         *     }
+         * };
+         */
+        template<typename T>
+        struct MessageTraits;
+
+        template<typename T>
+        struct PrimitiveMessageTraits {
+            static void write(JsonWriter& writer, const T& value) {
+                writer.value(value);
+            }
+            static bool read(JsonReader& reader, T& value) {
+                return reader.read(value);
+            }
+        };
+
+        template<> struct MessageTraits<bool> : PrimitiveMessageTraits<bool> {};
+        template<> struct MessageTraits<short> : PrimitiveMessageTraits<short> {};
+        template<> struct MessageTraits<unsigned short> : PrimitiveMessageTraits<unsigned short> {};
+        template<> struct MessageTraits<int> : PrimitiveMessageTraits<int> {};
+        template<> struct MessageTraits<unsigned int> : PrimitiveMessageTraits<unsigned int> {};
+        template<> struct MessageTraits<long> : PrimitiveMessageTraits<long> {};
+        template<> struct MessageTraits<unsigned long> : PrimitiveMessageTraits<unsigned long> {};
+        template<> struct MessageTraits<long long> : PrimitiveMessageTraits<long long> {};
+        template<> struct MessageTraits<unsigned long long> : PrimitiveMessageTraits<unsigned long long> {};
+        template<> struct MessageTraits<double> : PrimitiveMessageTraits<double> {};
+        template<> struct MessageTraits<std::string> : PrimitiveMessageTraits<std::string> {};
+
+        template<typename T>
+        struct MessageTraits<std::vector<T>> {
+            static void write(JsonWriter& writer, const std::vector<T>& value) {
+                writer.beginArray();
+                for(auto it = value.cbegin(); it != value.cend(); it++) {
+                    MessageTraits<T>::write(writer, *it);
+                }
+                writer.endArray();
+            }
+            static bool read(JsonReader& reader, std::vector<T>& value) {
+                value.clear();
+                if(!reader.beginArray())
+                    return false;
+                while(reader.nextElement()) {
+                    value.emplace_back();
+                    if(!MessageTraits<T>::read(reader, value.back()))
+                        return false;
+                }
+                return reader.ok();
+            }
+        };
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_MESSAGE_TRAITS_H__
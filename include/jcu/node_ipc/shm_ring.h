@@ -0,0 +1,139 @@
+/**
+ * @file	shm_ring.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_SHM_RING_H__
+#define __JCU_NODE_IPC_SHM_RING_H__
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * One endpoint of a shared memory byte pipe between two processes on the same host.
+         *
+         * The segment holds two single-producer single-consumer rings, one per direction,
+         * carrying the same delimited frame stream as a socket. Each endpoint sleeps on one
+         * futex word in the segment, which the peer bumps when it publishes data or frees
+         * space, so no file descriptor has to be passed between the peers.
+         * Only available on Linux; create()/open() return nullptr elsewhere.
+         *
+         * The library only attaches as a client (IpcShmConfig). The peer process is
+         * responsible for the server side, and a node-ipc server written in JavaScript does
+         * not do any of it:
+         *  - call create() with the name the client will open, before the client connects.
+         *    The default name is "/jcu-node-ipc.<IpcConfig::id>".
+         *  - serve exactly one client per segment: once the client attached, speak the
+         *    frame protocol over the ring instead of a socket connection.
+         *  - after close(), by either side, destroy the ring and create() a new one for the
+         *    next connection. Clients reconnect through the socket until it exists.
+         *
+         * Frames cross the ring unencrypted; the client does not use it when TLS is configured.
+         *
+         * The creating process is recorded in the segment. open() rejects (and unlinks) a
+         * segment whose creator is gone, so a crashed server does not strand its clients.
+         */
+        class ShmRing {
+        public:
+            enum {
+                READABLE = 1,
+                WRITABLE = 2
+            };
+
+            virtual ~ShmRing() {}
+
+            /**
+             * Create the segment (server side). An existing segment of the same name is replaced.
+             * @param name       shared memory object name, e.g. "/jcu-node-ipc.my-service"
+             * @param ring_size  bytes per direction, rounded up to a power of two
+             * @return nullptr on failure
+             */
+            static std::unique_ptr<ShmRing> create(const std::string& name, size_t ring_size);
+
+            /**
+             * Attach to a segment created by the peer (client side)
+             * @param name
+             * @return nullptr if the segment does not exist, already has a client or its
+             *         creator process has exited
+             */
+            static std::unique_ptr<ShmRing> open(const std::string& name);
+
+            /**
+             * Copy as much of data as fits into the outgoing ring. Never blocks.
+             * @return bytes written
+             */
+            virtual size_t write(const char *data, size_t length) = 0;
+
+            /**
+             * Contiguous readable region of the incoming ring, without copying
+             * @param data set to the start of the region
+             * @return region length, 0 if the ring is empty
+             */
+            virtual size_t peek(const char **data) = 0;
+
+            /**
+             * Release bytes returned by peek()
+             */
+            virtual void consume(size_t length) = 0;
+
+            virtual size_t readable() const = 0;
+            virtual size_t writable() const = 0;
+
+            /**
+             * Sequence number of this endpoint's futex. Read it before deciding which events
+             * to wait for, so an interrupt() in between is not lost.
+             */
+            virtual uint32_t eventSeq() const = 0;
+
+            /**
+             * Block until one of the events is ready, the peer closed, interrupt() was called
+             * or the timeout elapsed. Only one thread per endpoint may wait.
+             * @param events    READABLE and/or WRITABLE, 0 to wait for interrupt() only
+             * @param seq       value of eventSeq() read before
+             * @return the subset of events that is ready
+             */
+            virtual int waitEvent(int events, uint32_t seq, int timeout_ms) = 0;
+
+            /**
+             * Block until the incoming ring has data, the peer closed, or the timeout elapsed
+             * @return True if data is readable
+             */
+            virtual bool waitReadable(int timeout_ms) = 0;
+
+            /**
+             * Block until the outgoing ring has free space, the peer closed, or the timeout elapsed
+             * @return True if space is available
+             */
+            virtual bool waitWritable(int timeout_ms) = 0;
+
+            /**
+             * Wake a thread blocked in waitReadable()/waitWritable() of this endpoint
+             */
+            virtual void interrupt() = 0;
+
+            /**
+             * Mark the pipe closed for both sides. A segment serves a single client;
+             * the server creates a new one for the next connection.
+             */
+            virtual void close() = 0;
+            virtual bool isClosed() const = 0;
+
+            /**
+             * @return False once the peer process has exited. A server without a client yet
+             *         counts its peer as alive.
+             */
+            virtual bool peerAlive() const = 0;
+        };
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_SHM_RING_H__
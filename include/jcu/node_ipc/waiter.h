@@ -0,0 +1,120 @@
+/**
+ * @file	waiter.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __JCU_NODE_IPC_WAITER_H__
+#define __JCU_NODE_IPC_WAITER_H__
+
+#include "instance.h"
+
+namespace jcu {
+    namespace node_ipc {
+
+        struct WaiterList;
+
+        /**
+         * One-shot waiter for a client event.
+         * It is linked into the client intrusively, so waiting does not allocate.
+         * Waiters are registered and completed on the loop thread.
+         */
+        class Waiter {
+        public:
+            Waiter *prev_waiter_;
+            Waiter *next_waiter_;
+            WaiterList *wait_list_;
+
+            Waiter() : prev_waiter_(nullptr), next_waiter_(nullptr), wait_list_(nullptr) {}
+            virtual ~Waiter() {}
+
+            bool isWaiting() const {
+                return wait_list_ != nullptr;
+            }
+
+            /**
+             * Called once, after the waiter is unlinked
+             * @param message received message, nullptr for connect events or when the client is closed
+             */
+            virtual void onWaitComplete(IncomingMessage *message) = 0;
+        };
+
+        struct WaiterList {
+            Waiter *head;
+            Waiter *tail;
+
+            WaiterList() : head(nullptr), tail(nullptr) {}
+
+            bool empty() const {
+                return head == nullptr;
+            }
+
+            void push(Waiter *waiter) {
+                waiter->wait_list_ = this;
+                waiter->prev_waiter_ = tail;
+                waiter->next_waiter_ = nullptr;
+                if(tail)
+                    tail->next_waiter_ = waiter;
+                else
+                    head = waiter;
+                tail = waiter;
+            }
+
+            void remove(Waiter *waiter) {
+                if(waiter->prev_waiter_)
+                    waiter->prev_waiter_->next_waiter_ = waiter->next_waiter_;
+                else
+                    head = waiter->next_waiter_;
+                if(waiter->next_waiter_)
+                    waiter->next_waiter_->prev_waiter_ = waiter->prev_waiter_;
+                else
+                    tail = waiter->prev_waiter_;
+                waiter->prev_waiter_ = nullptr;
+                waiter->next_waiter_ = nullptr;
+                waiter->wait_list_ = nullptr;
+            }
+
+            Waiter *pop() {
+                Waiter *waiter = head;
+                if(waiter)
+                    remove(waiter);
+                return waiter;
+            }
+
+            /**
+             * Move all waiters into other, leaving this list empty
+             */
+            void moveTo(WaiterList& other) {
+                while(Waiter *waiter = pop()) {
+                    other.push(waiter);
+                }
+            }
+
+            /**
+             * Unlink every waiter without completing it
+             */
+            void clear() {
+                while(pop()) {
+                }
+            }
+
+            /**
+             * Complete every waiter currently in the list.
+             * Waiters added while completing are left for the next event.
+             */
+            void completeAll(IncomingMessage *message) {
+                WaiterList ready;
+                moveTo(ready);
+                while(Waiter *waiter = ready.pop()) {
+                    waiter->onWaitComplete(message);
+                }
+            }
+        };
+
+    }
+}
+
+#endif // __JCU_NODE_IPC_WAITER_H__
@@ -0,0 +1,339 @@
+/**
+ * Throughput and round-trip comparison of ShmLink against a TCP loopback connection.
+ *
+ * Both sides run their own uvw loop thread, as a client and a server process would,
+ * so the shared memory numbers include the helper thread and the async hop into the
+ * loop that the client pays on every wakeup.
+ *
+ * usage: bench-shm [frame_size] [frame_count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <future>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include <uvw/loop.hpp>
+#include <uvw/async.hpp>
+#include <uvw/tcp.hpp>
+
+#include <jcu/node_ipc/shm_ring.h>
+#include "shm_link.h"
+
+using jcu::node_ipc::ShmRing;
+using jcu::node_ipc::ShmLink;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * A uvw loop on its own thread, with a way to run code on it
+ */
+class LoopThread {
+public:
+    std::shared_ptr<uvw::Loop> loop;
+
+    LoopThread() {
+        loop = uvw::Loop::create();
+        async_ = loop->resource<uvw::AsyncHandle>();
+        async_->on<uvw::AsyncEvent>([this](uvw::AsyncEvent &evt, uvw::AsyncHandle &handle) -> void {
+            std::deque<std::function<void()>> tasks;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                tasks.swap(tasks_);
+            }
+            for(auto& task : tasks) {
+                task();
+            }
+        });
+        thread_ = std::thread([this]() -> void {
+            loop->run();
+        });
+    }
+
+    ~LoopThread() {
+        call([this]() -> void {
+            async_->close();
+            loop->stop();
+        });
+        thread_.join();
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            tasks_.push_back(task);
+        }
+        async_->send();
+    }
+
+    void call(std::function<void()> task) {
+        std::promise<void> done;
+        post([&]() -> void {
+            task();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+private:
+    std::shared_ptr<uvw::AsyncHandle> async_;
+    std::mutex mutex_;
+    std::deque<std::function<void()>> tasks_;
+    std::thread thread_;
+};
+
+/**
+ * One side of a connection. Everything is called on the owning loop thread.
+ */
+struct Endpoint {
+    std::function<void(const char *data, size_t length)> on_data;
+    std::function<void()> on_writable;
+
+    virtual ~Endpoint() {}
+    virtual void send(const char *data, size_t length) = 0;
+    /**
+     * @return True while written data is still queued in this process
+     */
+    virtual bool blocked() const = 0;
+    virtual void close() = 0;
+};
+
+struct ShmEndpoint : public Endpoint {
+    std::unique_ptr<ShmLink> link;
+
+    ShmEndpoint(std::shared_ptr<uvw::Loop> loop, std::unique_ptr<ShmRing> ring)
+        : link(new ShmLink(loop, std::move(ring))) {
+        link->onDrain([this]() -> void {
+            if(on_writable)
+                on_writable();
+        });
+        link->start([this](const char *data, size_t length) -> void {
+            on_data(data, length);
+        }, nullptr);
+    }
+
+    void send(const char *data, size_t length) override {
+        std::unique_ptr<char[]> buf(new char[length]);
+        memcpy(buf.get(), data, length);
+        link->write(std::move(buf), length);
+    }
+    bool blocked() const override {
+        return link->pendingBytes() > 0;
+    }
+    void close() override {
+        link->close();
+    }
+};
+
+struct TcpEndpoint : public Endpoint {
+    std::shared_ptr<uvw::TCPHandle> tcp;
+
+    TcpEndpoint(std::shared_ptr<uvw::TCPHandle> handle) : tcp(handle) {
+        tcp->noDelay(true);
+        tcp->on<uvw::DataEvent>([this](uvw::DataEvent &evt, uvw::TCPHandle &handle) -> void {
+            on_data(evt.data.get(), evt.length);
+        });
+        tcp->on<uvw::WriteEvent>([this](uvw::WriteEvent &evt, uvw::TCPHandle &handle) -> void {
+            if(on_writable && handle.writeQueueSize() == 0)
+                on_writable();
+        });
+        tcp->on<uvw::ErrorEvent>([](uvw::ErrorEvent &evt, uvw::TCPHandle &handle) -> void {
+            fprintf(stderr, "tcp: %s\n", evt.what());
+            exit(1);
+        });
+        tcp->read();
+    }
+
+    void send(const char *data, size_t length) override {
+        std::unique_ptr<char[]> buf(new char[length]);
+        memcpy(buf.get(), data, length);
+        tcp->write(std::move(buf), (unsigned int)length);
+    }
+    bool blocked() const override {
+        return tcp->writeQueueSize() > 0;
+    }
+    void close() override {
+        tcp->close();
+    }
+};
+
+static void shmPair(LoopThread& client_loop, LoopThread& server_loop,
+                    std::unique_ptr<Endpoint>& client, std::unique_ptr<Endpoint>& server) {
+    std::string shm_name = "/jcu-node-ipc.bench." + std::to_string(getpid());
+    std::unique_ptr<ShmRing> server_ring = ShmRing::create(shm_name, 1 << 20);
+    std::unique_ptr<ShmRing> client_ring = server_ring ? ShmRing::open(shm_name) : nullptr;
+    if(!client_ring) {
+        fprintf(stderr, "shared memory ring unavailable\n");
+        exit(1);
+    }
+    server_loop.call([&]() -> void {
+        server.reset(new ShmEndpoint(server_loop.loop, std::move(server_ring)));
+    });
+    client_loop.call([&]() -> void {
+        client.reset(new ShmEndpoint(client_loop.loop, std::move(client_ring)));
+    });
+}
+
+static void tcpPair(LoopThread& client_loop, LoopThread& server_loop,
+                    std::unique_ptr<Endpoint>& client, std::unique_ptr<Endpoint>& server) {
+    std::promise<void> accepted, connected;
+    std::shared_ptr<uvw::TCPHandle> listener;
+    int port = 0;
+    server_loop.call([&]() -> void {
+        listener = server_loop.loop->resource<uvw::TCPHandle>();
+        listener->once<uvw::ListenEvent>([&](uvw::ListenEvent &evt, uvw::TCPHandle &handle) -> void {
+            std::shared_ptr<uvw::TCPHandle> conn = handle.loop().resource<uvw::TCPHandle>();
+            handle.accept(*conn);
+            server.reset(new TcpEndpoint(conn));
+            handle.close();
+            accepted.set_value();
+        });
+        listener->bind("127.0.0.1", 0);
+        listener->listen();
+        port = (int)listener->sock().port;
+    });
+    client_loop.call([&]() -> void {
+        std::shared_ptr<uvw::TCPHandle> conn = client_loop.loop->resource<uvw::TCPHandle>();
+        conn->once<uvw::ConnectEvent>([&, conn](uvw::ConnectEvent &evt, uvw::TCPHandle &handle) -> void {
+            client.reset(new TcpEndpoint(conn));
+            connected.set_value();
+        });
+        conn->connect("127.0.0.1", (unsigned int)port);
+    });
+    accepted.get_future().wait();
+    connected.get_future().wait();
+}
+
+/**
+ * Detach the callbacks of a finished run before its locals go away
+ */
+static void detach(LoopThread& client_loop, LoopThread& server_loop, Endpoint& client, Endpoint& server) {
+    client_loop.call([&]() -> void {
+        client.on_data = [](const char *data, size_t length) -> void {};
+        client.on_writable = nullptr;
+    });
+    server_loop.call([&]() -> void {
+        server.on_data = [](const char *data, size_t length) -> void {};
+    });
+}
+
+static void runThroughput(const char *name, LoopThread& client_loop, LoopThread& server_loop,
+                          Endpoint& client, Endpoint& server, size_t frame_size, size_t count) {
+    std::string frame(frame_size, 'x');
+    frame[frame_size - 1] = 0x0c;
+    size_t total = frame_size * count;
+    size_t received = 0;
+    size_t sent = 0;
+    std::promise<Clock::time_point> done;
+
+    server_loop.call([&]() -> void {
+        server.on_data = [&](const char *data, size_t length) -> void {
+            received += length;
+            if(received == total)
+                done.set_value(Clock::now());
+        };
+    });
+
+    Clock::time_point begin = Clock::now();
+    client_loop.post([&]() -> void {
+        // Keep the writer ahead of the reader without queueing the whole run in memory
+        client.on_writable = [&]() -> void {
+            while(sent < count && !client.blocked()) {
+                client.send(frame.data(), frame.size());
+                sent++;
+            }
+        };
+        client.on_writable();
+    });
+    double seconds = std::chrono::duration<double>(done.get_future().get() - begin).count();
+    detach(client_loop, server_loop, client, server);
+
+    printf("%-6s throughput: %10.0f frames/s %10.1f MB/s\n", name, count / seconds, (double)total / seconds / 1e6);
+}
+
+static void runRoundTrip(const char *name, LoopThread& client_loop, LoopThread& server_loop,
+                         Endpoint& client, Endpoint& server, size_t frame_size, size_t count) {
+    std::string frame(frame_size, 'y');
+    frame[frame_size - 1] = 0x0c;
+    size_t server_partial = 0;
+    size_t client_partial = 0;
+    size_t completed = 0;
+    std::promise<Clock::time_point> done;
+
+    server_loop.call([&]() -> void {
+        server.on_data = [&](const char *data, size_t length) -> void {
+            server_partial += length;
+            while(server_partial >= frame_size) {
+                server_partial -= frame_size;
+                server.send(frame.data(), frame.size());
+            }
+        };
+    });
+    client_loop.call([&]() -> void {
+        client.on_data = [&](const char *data, size_t length) -> void {
+            client_partial += length;
+            while(client_partial >= frame_size) {
+                client_partial -= frame_size;
+                if(++completed == count) {
+                    done.set_value(Clock::now());
+                    return;
+                }
+                client.send(frame.data(), frame.size());
+            }
+        };
+    });
+
+    Clock::time_point begin = Clock::now();
+    client_loop.post([&]() -> void {
+        client.send(frame.data(), frame.size());
+    });
+    double seconds = std::chrono::duration<double>(done.get_future().get() - begin).count();
+    detach(client_loop, server_loop, client, server);
+
+    printf("%-6s round trip: %10.2f us\n", name, seconds * 1e6 / count);
+}
+
+static void runAll(const char *name, LoopThread& client_loop, LoopThread& server_loop,
+                   std::unique_ptr<Endpoint>& client, std::unique_ptr<Endpoint>& server,
+                   size_t frame_size, size_t count) {
+    runThroughput(name, client_loop, server_loop, *client, *server, frame_size, count);
+    size_t rtt_count = count / 10 ? count / 10 : 1;
+    runRoundTrip(name, client_loop, server_loop, *client, *server, frame_size, rtt_count);
+
+    client_loop.call([&]() -> void {
+        client->close();
+        client.reset();
+    });
+    server_loop.call([&]() -> void {
+        server->close();
+        server.reset();
+    });
+}
+
+int main(int argc, char *argv[]) {
+    size_t frame_size = (argc > 1) ? (size_t)atol(argv[1]) : 256;
+    size_t count = (argc > 2) ? (size_t)atol(argv[2]) : 1000000;
+    if(frame_size < 1)
+        frame_size = 1;
+
+    LoopThread client_loop;
+    LoopThread server_loop;
+    std::unique_ptr<Endpoint> client, server;
+
+    printf("frame size %zu, %zu frames\n", frame_size, count);
+
+    shmPair(client_loop, server_loop, client, server);
+    runAll("shm", client_loop, server_loop, client, server, frame_size, count);
+
+    tcpPair(client_loop, server_loop, client, server);
+    runAll("tcp", client_loop, server_loop, client, server, frame_size, count);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Replays the inbound side of a capture file through the client's decoder and dispatch.
+ *
+ * usage: replay <capture> [--paced] [--decode] [--repeat N]
+ *        replay --synth <capture> [frame_count] [data_size]
+ *
+ * --paced   reproduce the recorded arrival times instead of running at full speed
+ * --decode  parse the data of every message, not only the envelope
+ * --synth   write a capture of generated frames, split at odd read boundaries
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+
+#include <jcu/node_ipc/client.h>
+#include <jcu/node_ipc/capture.h>
+
+using namespace jcu::node_ipc;
+
+class CountingHandler : public MessageHandler {
+public:
+    bool decode;
+    uint64_t messages;
+    uint64_t members;
+
+    CountingHandler(bool d) : decode(d), messages(0), members(0) {}
+
+    void invoke(IncomingMessage& message) override {
+        messages++;
+        if(decode) {
+            members += message.json().size();
+        }
+    }
+};
+
+static void putLE(FILE *fp, uint64_t v, int bytes) {
+    for(int i = 0; i < bytes; i++) {
+        fputc((int)((v >> (i * 8)) & 0xff), fp);
+    }
+}
+
+static int synth(const char *path, size_t count, size_t data_size) {
+    FILE *fp = fopen(path, "wb");
+    if(!fp) {
+        fprintf(stderr, "cannot create %s\n", path);
+        return 1;
+    }
+    fwrite("JNIC", 1, 4, fp);
+    putLE(fp, 1, 2);
+    putLE(fp, 0, 2);
+    putLE(fp, 0, 8);
+
+    std::string stream;
+    std::string payload(data_size, 'x');
+    char head[96];
+    for(size_t i = 0; i < count; i++) {
+        snprintf(head, sizeof(head), "{\"type\":\"tick\",\"data\":{\"seq\":%zu,\"price\":%zu.25,\"note\":\"", i, i % 1000);
+        stream.append(head);
+        stream.append(payload);
+        stream.append("\"}}\x0c");
+    }
+
+    // Reads of varying size so frames straddle record boundaries, 1us apart
+    size_t offset = 0;
+    uint64_t ts = 0;
+    size_t chunk = 1000;
+    while(offset < stream.length()) {
+        size_t n = stream.length() - offset;
+        if(n > chunk)
+            n = chunk;
+        fputc(CAPTURE_INBOUND, fp);
+        putLE(fp, ts, 8);
+        putLE(fp, n, 4);
+        fwrite(stream.data() + offset, 1, n, fp);
+        offset += n;
+        ts += 1000;
+        chunk = (chunk * 7 + 311) % 65536 + 64;
+    }
+    fclose(fp);
+    printf("wrote %zu frames, %zu bytes\n", count, stream.length());
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc >= 3 && !strcmp(argv[1], "--synth")) {
+        size_t count = (argc > 3) ? (size_t)atol(argv[3]) : 1000000;
+        size_t data_size = (argc > 4) ? (size_t)atol(argv[4]) : 32;
+        return synth(argv[2], count, data_size);
+    }
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [--paced] [--decode] [--repeat N]\n", argv[0]);
+        fprintf(stderr, "       %s --synth <capture> [frame_count] [data_size]\n", argv[0]);
+        return 1;
+    }
+
+    ReplayPacing pacing = REPLAY_FULL_SPEED;
+    bool decode = false;
+    int repeat = 1;
+    for(int i = 2; i < argc; i++) {
+        if(!strcmp(argv[i], "--paced")) {
+            pacing = REPLAY_RECORDED;
+        }else if(!strcmp(argv[i], "--decode")) {
+            decode = true;
+        }else if(!strcmp(argv[i], "--repeat") && (i + 1) < argc) {
+            repeat = atoi(argv[++i]);
+        }
+    }
+
+    std::unique_ptr<CaptureFile> file = CaptureFile::open(argv[1]);
+    if(!file) {
+        fprintf(stderr, "cannot open capture %s\n", argv[1]);
+        return 1;
+    }
+
+    auto client = Client::create();
+    CountingHandler *handler = new CountingHandler(decode);
+    client->addMessageHandler("*", std::unique_ptr<MessageHandler>(handler), MessageDispatchOptions());
+
+    for(int i = 0; i < repeat; i++) {
+        uint64_t before = handler->messages;
+        ReplayStats stats = replayCapture(*file, *client, pacing);
+        uint64_t messages = handler->messages - before;
+        printf("pass %d: %llu reads, %llu messages in %.3f s: %10.0f msg/s %8.1f MB/s\n",
+            i + 1, (unsigned long long)stats.records, (unsigned long long)messages, stats.seconds,
+            messages / stats.seconds, stats.bytes / stats.seconds / 1e6);
+    }
+    return 0;
+}
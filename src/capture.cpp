@@ -0,0 +1,207 @@
+/**
+ * @file	capture.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "capture_writer.h"
+
+#include <jcu/node_ipc/client.h>
+
+#include <string.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace jcu {
+    namespace node_ipc {
+
+        static const char CAPTURE_MAGIC[4] = { 'J', 'N', 'I', 'C' };
+        static const uint16_t CAPTURE_VERSION = 1;
+        static const size_t CAPTURE_HEADER_SIZE = 16;
+        static const size_t CAPTURE_RECORD_HEADER_SIZE = 13;
+        static const size_t CAPTURE_WRITE_BUFFER = 1024 * 1024;
+
+        static void putLE(unsigned char *p, uint64_t v, int bytes) {
+            for(int i = 0; i < bytes; i++) {
+                p[i] = (unsigned char)(v >> (i * 8));
+            }
+        }
+
+        static uint64_t getLE(const unsigned char *p, int bytes) {
+            uint64_t v = 0;
+            for(int i = bytes - 1; i >= 0; i--) {
+                v = (v << 8) | p[i];
+            }
+            return v;
+        }
+
+        CaptureWriter::CaptureWriter(FILE *fp) : fp_(fp), buffer_(new char[CAPTURE_WRITE_BUFFER]) {
+            setvbuf(fp_, buffer_.get(), _IOFBF, CAPTURE_WRITE_BUFFER);
+            start_ = std::chrono::steady_clock::now();
+
+            unsigned char header[CAPTURE_HEADER_SIZE];
+            memcpy(header, CAPTURE_MAGIC, 4);
+            putLE(header + 4, CAPTURE_VERSION, 2);
+            putLE(header + 6, 0, 2);
+            uint64_t wall_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            putLE(header + 8, wall_ns, 8);
+            fwrite(header, 1, sizeof(header), fp_);
+        }
+
+        CaptureWriter::~CaptureWriter() {
+            fclose(fp_);
+        }
+
+        std::unique_ptr<CaptureWriter> CaptureWriter::create(const std::string& path) {
+            FILE *fp = fopen(path.c_str(), "wb");
+            if(!fp)
+                return nullptr;
+            return std::unique_ptr<CaptureWriter>(new CaptureWriter(fp));
+        }
+
+        void CaptureWriter::write(CaptureDirection direction, const char *data, size_t length) {
+            unsigned char header[CAPTURE_RECORD_HEADER_SIZE];
+            uint64_t ts = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+            header[0] = (unsigned char)direction;
+            putLE(header + 1, ts, 8);
+            putLE(header + 9, (uint64_t)length, 4);
+            fwrite(header, 1, sizeof(header), fp_);
+            fwrite(data, 1, length, fp_);
+        }
+
+        class CaptureFileImpl : public CaptureFile {
+        private:
+            const unsigned char *data_;
+            size_t size_;
+#ifdef _WIN32
+            HANDLE file_;
+            HANDLE mapping_;
+#endif
+
+        public:
+#ifdef _WIN32
+            CaptureFileImpl(const unsigned char *data, size_t size, HANDLE file, HANDLE mapping)
+                : data_(data), size_(size), file_(file), mapping_(mapping) {}
+            ~CaptureFileImpl() override {
+                UnmapViewOfFile(data_);
+                CloseHandle(mapping_);
+                CloseHandle(file_);
+            }
+#else
+            CaptureFileImpl(const unsigned char *data, size_t size) : data_(data), size_(size) {}
+            ~CaptureFileImpl() override {
+                munmap((void *)data_, size_);
+            }
+#endif
+
+            uint64_t startTime() const override {
+                return getLE(data_ + 8, 8);
+            }
+
+            bool next(size_t& offset, CaptureRecord& record) const override {
+                size_t pos = (offset < CAPTURE_HEADER_SIZE) ? CAPTURE_HEADER_SIZE : offset;
+                if(size_ - pos < CAPTURE_RECORD_HEADER_SIZE)
+                    return false;
+                const unsigned char *p = data_ + pos;
+                size_t length = (size_t)getLE(p + 9, 4);
+                if(size_ - pos - CAPTURE_RECORD_HEADER_SIZE < length)
+                    return false;
+                record.direction = (CaptureDirection)p[0];
+                record.timestamp_ns = getLE(p + 1, 8);
+                record.data = (const char *)(p + CAPTURE_RECORD_HEADER_SIZE);
+                record.length = length;
+                offset = pos + CAPTURE_RECORD_HEADER_SIZE + length;
+                return true;
+            }
+
+            static bool validHeader(const unsigned char *data, size_t size) {
+                return size >= CAPTURE_HEADER_SIZE && !memcmp(data, CAPTURE_MAGIC, 4) && getLE(data + 4, 2) == CAPTURE_VERSION;
+            }
+        };
+
+        std::unique_ptr<CaptureFile> CaptureFile::open(const std::string& path) {
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if(file == INVALID_HANDLE_VALUE)
+                return nullptr;
+            LARGE_INTEGER file_size;
+            if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)CAPTURE_HEADER_SIZE) {
+                CloseHandle(file);
+                return nullptr;
+            }
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if(!mapping) {
+                CloseHandle(file);
+                return nullptr;
+            }
+            const unsigned char *data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size_t size = (size_t)file_size.QuadPart;
+            if(!data || !CaptureFileImpl::validHeader(data, size)) {
+                if(data)
+                    UnmapViewOfFile(data);
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return nullptr;
+            }
+            return std::unique_ptr<CaptureFile>(new CaptureFileImpl(data, size, file, mapping));
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return nullptr;
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (size_t)st.st_size < CAPTURE_HEADER_SIZE) {
+                ::close(fd);
+                return nullptr;
+            }
+            size_t size = (size_t)st.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(mapped == MAP_FAILED)
+                return nullptr;
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            const unsigned char *data = (const unsigned char *)mapped;
+            if(!CaptureFileImpl::validHeader(data, size)) {
+                munmap(mapped, size);
+                return nullptr;
+            }
+            return std::unique_ptr<CaptureFile>(new CaptureFileImpl(data, size));
+#endif
+        }
+
+        ReplayStats replayCapture(const CaptureFile& file, Client& client, ReplayPacing pacing) {
+            ReplayStats stats;
+            stats.records = 0;
+            stats.bytes = 0;
+
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            size_t offset = 0;
+            CaptureRecord record;
+            while(file.next(offset, record)) {
+                if(record.direction != CAPTURE_INBOUND)
+                    continue;
+                if(pacing == REPLAY_RECORDED) {
+                    std::this_thread::sleep_until(begin + std::chrono::nanoseconds(record.timestamp_ns));
+                }
+                client.feed(record.data, record.length);
+                stats.records++;
+                stats.bytes += record.length;
+            }
+            // Offloaded handlers are part of the replay
+            client.waitIdle();
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            return stats;
+        }
+
+    }
+}
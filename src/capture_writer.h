@@ -0,0 +1,48 @@
+/**
+ * @file	capture_writer.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __SRC_CAPTURE_WRITER_H__
+#define __SRC_CAPTURE_WRITER_H__
+
+#include <jcu/node_ipc/capture.h>
+
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * Appends records to a capture file through a large stdio buffer
+         */
+        class CaptureWriter {
+        private:
+            FILE *fp_;
+            std::unique_ptr<char[]> buffer_;
+            std::chrono::steady_clock::time_point start_;
+
+            CaptureWriter(FILE *fp);
+
+        public:
+            ~CaptureWriter();
+
+            /**
+             * @param path created or truncated
+             * @return nullptr on failure
+             */
+            static std::unique_ptr<CaptureWriter> create(const std::string& path);
+
+            void write(CaptureDirection direction, const char *data, size_t length);
+        };
+
+    }
+}
+
+#endif // __SRC_CAPTURE_WRITER_H__
@@ -9,15 +9,27 @@
 
 #include <jcu/node_ipc/client.h>
 #include <jcu/node_ipc/ipc_config.h>
+#include <jcu/node_ipc/json_stream.h>
 
+#include "message_frame.h"
+#include "shm_link.h"
+#include "capture_writer.h"
 #include "utils/trie_search.h"
+#include "utils/worker_pool.h"
+#include "utils/rtt_histogram.h"
 
 #include <jcu/transport/tcp_transport.h>
 #include <jcu/transport/tls_transport.h>
 
 #include <uvw/timer.hpp>
+#include <uvw/async.hpp>
 
-#include <iostream>
+#include <string.h>
+#include <mutex>
+#include <deque>
+#include <list>
+#include <map>
+#include <chrono>
 #include <json/json.h>
 
 namespace jcu {
@@ -44,29 +56,96 @@ namespace jcu {
 
         };
 
-        class ClientImpl : public Client {
+        class HeartbeatTimeoutError : public transport::Error {
+        public:
+            std::string what_;
+
+            HeartbeatTimeoutError(int missed) : what_("no heartbeat reply for " + std::to_string(missed) + " pings") {}
+
+            const char *what() const override {
+                return what_.c_str();
+            }
+            const char *name() const override {
+                return "HeartbeatTimeoutError";
+            }
+            int code() const override {
+                return 0;
+            }
+            explicit operator bool() const override {
+                return true;
+            }
+
+        };
+
+        class InputBacklogOverflowError : public transport::Error {
+        public:
+            std::string what_;
+
+            InputBacklogOverflowError(size_t limit) : what_("input backlog exceeded " + std::to_string(limit) + " bytes while workers are busy") {}
+
+            const char *what() const override {
+                return what_.c_str();
+            }
+            const char *name() const override {
+                return "InputBacklogOverflowError";
+            }
+            int code() const override {
+                return 0;
+            }
+            explicit operator bool() const override {
+                return true;
+            }
+
+        };
+
+        class ClientImpl : public Client, public DecodeErrorSink {
         private:
-            struct MessageCallbackHolder {
-                virtual void invoke(Json::Value &data, const std::string& type) = 0;
-            };
-            struct NormalMessageCallbackHolder : public MessageCallbackHolder {
+            struct NormalMessageHandler : public MessageHandler {
                 OnMessage_t func_;
 
-                NormalMessageCallbackHolder(const OnMessage_t& func) : func_(func) {}
+                NormalMessageHandler(const OnMessage_t& func) : func_(func) {}
 
-                void invoke(Json::Value &data, const std::string& type) {
-                    func_(data);
+                void invoke(IncomingMessage &message) override {
+                    if(!message.parseJson())
+                        return;
+                    func_(message.json());
                 }
             };
-            struct WithTypeMessageCallbackHolder : public MessageCallbackHolder {
+            struct WithTypeMessageHandler : public MessageHandler {
                 OnMessageWithType_t func_;
 
-                WithTypeMessageCallbackHolder(const OnMessageWithType_t& func) : func_(func) {}
+                WithTypeMessageHandler(const OnMessageWithType_t& func) : func_(func) {}
 
-                void invoke(Json::Value &data, const std::string& type) {
-                    func_(data, type);
+                void invoke(IncomingMessage &message) override {
+                    if(!message.parseJson())
+                        return;
+                    func_(message.json(), message.type());
                 }
             };
+            struct HeartbeatHandler : public MessageHandler {
+                ClientImpl *client_;
+                bool is_ping_;
+
+                HeartbeatHandler(ClientImpl *client, bool is_ping) : client_(client), is_ping_(is_ping) {}
+
+                void invoke(IncomingMessage &message) override {
+                    if(is_ping_)
+                        client_->onHeartbeatPing(message);
+                    else
+                        client_->onHeartbeatPong(message);
+                }
+            };
+            struct MessageCallbackHolder {
+                MessageDispatchOptions options_;
+                std::unique_ptr<MessageHandler> handler_;
+
+                // With options_.conflate: the newest frame per key not yet taken by a worker
+                std::mutex conflate_mutex_;
+                std::map<std::string, std::shared_ptr<MessageFrame>> conflate_pending_;
+
+                MessageCallbackHolder(std::unique_ptr<MessageHandler> handler, const MessageDispatchOptions& options)
+                    : options_(options), handler_(std::move(handler)) {}
+            };
 
         public:
             int state_;
@@ -81,12 +160,88 @@ namespace jcu {
 
             std::shared_ptr<transport::Transport> transport_;
 
-            std::unique_ptr<Json::CharReader> json_reader_;
+            // Used instead of transport_ when the peer offered a shared memory ring
+            std::shared_ptr<ShmLink> shm_link_;
+
+            // Last connection target, used when the client connects again by itself
+            std::string conn_id_;
+            std::string conn_host_;
+            int conn_port_;
+            ConnectCallback_t connect_callback_;
+
+            typedef std::chrono::steady_clock HeartbeatClock;
+            std::shared_ptr<uvw::TimerHandle> heartbeat_timer_;
+            bool heartbeat_registered_;
+            uint32_t heartbeat_seq_;
+            std::deque<std::pair<uint32_t, HeartbeatClock::time_point>> heartbeat_pending_;
+            uint64_t heartbeat_sent_;
+            uint64_t heartbeat_received_;
+            utils::RttHistogram heartbeat_rtt_;
+
+            // Bytes of a frame whose delimiter has not arrived yet
+            std::string recv_buffer_;
+
+            // Set while the worker pool is saturated: input is not dispatched but kept here,
+            // and the shm ring is not consumed
+            bool input_paused_;
+            std::string input_backlog_;
+
+            std::unique_ptr<CaptureWriter> capture_;
+
+            WaiterList connect_waiters_;
+            std::map<std::string, WaiterList> message_waiters_;
+
+            // Frames emitted from worker threads, written out on the loop thread
+            std::mutex outbound_mutex_;
+            std::deque<std::pair<std::unique_ptr<char[]>, size_t>> outbound_queue_;
+            std::shared_ptr<uvw::AsyncHandle> outbound_async_;
+
+            // Decode errors raised on worker threads, reported to on_error_ on the loop thread
+            std::deque<std::string> deferred_errors_;
+
+            // Latest-value policies by message type. The held back frames are guarded by outbound_mutex_
+            struct ConflatedFrame {
+                std::string key;
+                std::unique_ptr<char[]> frame;
+                size_t length;
+            };
+            struct ConflationPolicy {
+                ConflationKeyFunc_t key_func;
+                std::shared_ptr<ConflationKeyExtractor> key_extractor;
+
+                bool keyed() const {
+                    return key_func || key_extractor;
+                }
+            };
+            std::map<std::string, ConflationPolicy> conflation_;
+            std::list<ConflatedFrame> conflated_queue_;
+            std::map<std::string, std::list<ConflatedFrame>::iterator> conflated_index_;
+
+            // Declared last so workers are joined before the handlers they reference are destroyed
+            std::unique_ptr<utils::WorkerPool> worker_pool_;
 
             ClientImpl() {
-                Json::CharReaderBuilder reader_builder;
-                json_reader_.reset(reader_builder.newCharReader());
                 state_ = 0;
+                conn_port_ = 0;
+                heartbeat_registered_ = false;
+                heartbeat_seq_ = 0;
+                heartbeat_sent_ = 0;
+                heartbeat_received_ = 0;
+                input_paused_ = false;
+            }
+            ~ClientImpl() {
+                worker_pool_.reset();
+                // Suspended awaiters unlink themselves when their coroutine is destroyed
+                connect_waiters_.clear();
+                for(auto it = message_waiters_.begin(); it != message_waiters_.end(); it++) {
+                    it->second.clear();
+                }
+                if(heartbeat_timer_) {
+                    heartbeat_timer_->close();
+                }
+                if(outbound_async_) {
+                    outbound_async_->close();
+                }
             }
             std::shared_ptr<IpcSession> of(const std::string &name) override {
                 return std::shared_ptr<IpcSession>();
@@ -98,6 +253,36 @@ namespace jcu {
                     transport->cleanup();
                     transport_.reset();
                 }
+                if(shm_link_) {
+                    // Kept until the next connect: close() may run inside the link's data callback
+                    shm_link_->close();
+                }
+                if(heartbeat_timer_) {
+                    heartbeat_timer_->stop();
+                }
+                heartbeat_pending_.clear();
+                resetInput();
+                std::unique_lock<std::mutex> lock(outbound_mutex_);
+                outbound_queue_.clear();
+                deferred_errors_.clear();
+                conflated_queue_.clear();
+                conflated_index_.clear();
+                if(outbound_async_) {
+                    outbound_async_->close();
+                    outbound_async_.reset();
+                }
+                lock.unlock();
+
+                releaseWaiters();
+            }
+            void releaseWaiters() {
+                connect_waiters_.completeAll(nullptr);
+                for(auto it = message_waiters_.begin(); it != message_waiters_.end(); it++) {
+                    it->second.completeAll(nullptr);
+                }
+            }
+            bool isConnected() const override {
+                return state_ == 2;
             }
             void onError(ErrorCallback_t on_error) override {
                 on_error_ = on_error;
@@ -110,8 +295,26 @@ namespace jcu {
                 std::string conn_host = host.empty() ? config_.networkHost : host;
                 int conn_port = (port <= 0) ? config_.networkPort : port;
 
+                conn_id_ = id;
+                conn_host_ = host;
+                conn_port_ = port;
+                connect_callback_ = connect_callback;
+
                 std::shared_ptr<uvw::Loop> loop = config_.loop ? config_.loop : uvw::Loop::getDefault();
 
+                prepareOutbound(loop);
+
+                // The ring is not encrypted: a TLS configuration always goes through the socket
+                if(config_.shm.enabled && !config_.tls.engine) {
+                    std::string shm_name = config_.shm.name.empty() ? ("/jcu-node-ipc." + conn_id) : config_.shm.name;
+                    std::unique_ptr<ShmRing> ring = ShmRing::open(shm_name);
+                    if(ring) {
+                        connectToShm(loop, std::move(ring));
+                        return;
+                    }
+                    // No shared memory peer: fall back to the socket
+                }
+
                 std::shared_ptr<transport::Transport> transport;
                 if(config_.network_transport_factory) {
                     transport = config_.network_transport_factory(loop, conn_host, conn_port);
@@ -127,53 +330,246 @@ namespace jcu {
                 state_ = 1;
 
                 transport->onData([this](transport::Transport& transport, std::unique_ptr<char[]> data, size_t length) -> void {
-                    char *begin_ptr = data.get();
-                    char *end_ptr = begin_ptr + length;
-                    char *cur = begin_ptr;
-
-                    while(cur != end_ptr) {
-                        if(*cur == 0x0c) {
-                            Json::Value doc;
-                            std::string err_text;
-                            if(json_reader_->parse(begin_ptr, cur, &doc, &err_text)) {
-                                std::string type = doc["type"].asString();
-                                auto callback = data_handlers_.typedSearch(type);
-                                std::cout << "type = " << type << std::endl;
-                                if(callback) {
-                                    for(auto it = callback->begin(); it != callback->end(); it++) {
-                                        (*it)->invoke(doc["data"], type);
-                                    }
-                                }
-                            }else{
-                                JsonParseError err(err_text);
-                                bool reconnect = false;
-                                on_error_(err, reconnect);
-                            }
-                        }
-                        cur++;
-                    }
+                    onTransportData(data.get(), length);
                 });
-                transport->connect([this, connect_callback](transport::Transport& transport) -> void {
+                transport->connect([this, loop](transport::Transport& transport) -> void {
                     // OK
-                    state_ = 2;
-                    if(connect_callback) {
-                        connect_callback();
-                    }
+                    onConnected(loop);
                 }, [this, loop](transport::Transport& transport) -> void {
                     // Close
-                  reconnect();
+                    if(state_ == 2) {
+                        state_ = 1;
+                    }
+                    reconnect();
                 }, [this, loop](transport::Transport& transport, transport::Error& err) -> void {
                     bool flag_reconnect = true;
                     if(on_error_) {
                         on_error_(err, flag_reconnect);
                         if(!flag_reconnect) {
+                            // Gave up: nothing will connect or arrive for the waiters
                             state_ = 0;
+                            releaseWaiters();
                         }
                     }
                 });
 
                 transport_ = transport;
+                shm_link_.reset();
+            }
+            void prepareOutbound(const std::shared_ptr<uvw::Loop>& loop) {
+                std::unique_lock<std::mutex> lock(outbound_mutex_);
+                if(!outbound_async_) {
+                    outbound_async_ = loop->resource<uvw::AsyncHandle>();
+                    // Also woken by the worker pool when it has room for paused input
+                    outbound_async_->on<uvw::AsyncEvent>([this](uvw::AsyncEvent &evt, uvw::AsyncHandle &handle) -> void {
+                        reportDeferredErrors();
+                        flushOutbound();
+                        resumeInput();
+                    });
+                }
+            }
+
+            void connectToShm(const std::shared_ptr<uvw::Loop>& loop, std::unique_ptr<ShmRing> ring) {
+                std::shared_ptr<ShmLink> link(new ShmLink(loop, std::move(ring)));
+                shm_link_ = link;
+                transport_.reset();
+
+                link->onDrain([this]() -> void {
+                    flushConflated();
+                });
+                if(input_paused_) {
+                    // Frames of the previous connection are still waiting for the workers
+                    link->pause();
+                }
+                link->start([this](const char *data, size_t length) -> void {
+                    onTransportData(data, length);
+                }, [this, loop]() -> void {
+                    // The ring is single use; connect again, to a new ring or the socket
+                    if(state_ <= 0)
+                        return;
+                    state_ = 1;
+                    auto timer = loop->resource<uvw::TimerHandle>();
+                    timer->once<uvw::TimerEvent>([this](uvw::TimerEvent &evt, uvw::TimerHandle& timer) -> void {
+                        timer.close();
+                        if(state_ > 0) {
+                            connectToNet(conn_id_, conn_host_, conn_port_, connect_callback_);
+                        }
+                    });
+                    timer->start(uvw::TimerHandle::Time{config_.retry}, uvw::TimerHandle::Time{0});
+                });
+
+                onConnected(loop);
+            }
+
+            void onConnected(const std::shared_ptr<uvw::Loop>& loop) {
+                state_ = 2;
+                dropPartialInput();
+                startHeartbeat(loop);
+                flushConflated();
+                if(connect_callback_) {
+                    connect_callback_();
+                }
+                connect_waiters_.completeAll(nullptr);
+            }
+
+            void startHeartbeat(const std::shared_ptr<uvw::Loop>& loop) {
+                const IpcHeartbeatConfig &heartbeat = config_.heartbeat;
+                heartbeat_pending_.clear();
+
+                if(!heartbeat_registered_) {
+                    heartbeat_registered_ = true;
+                    // Answer the peer's pings even when this side does not send any
+                    std::unique_ptr<MessageHandler> ping_handler(new HeartbeatHandler(this, true));
+                    addMessageHandler(heartbeat.ping_type, std::move(ping_handler), MessageDispatchOptions());
+                    if(heartbeat.interval > 0) {
+                        std::unique_ptr<MessageHandler> pong_handler(new HeartbeatHandler(this, false));
+                        addMessageHandler(heartbeat.pong_type, std::move(pong_handler), MessageDispatchOptions());
+                    }
+                }
+                if(heartbeat.interval <= 0)
+                    return;
+
+                if(!heartbeat_timer_) {
+                    heartbeat_timer_ = loop->resource<uvw::TimerHandle>();
+                    heartbeat_timer_->on<uvw::TimerEvent>([this](uvw::TimerEvent &evt, uvw::TimerHandle &timer) -> void {
+                        onHeartbeatTimer();
+                    });
+                }
+                heartbeat_timer_->start(uvw::TimerHandle::Time{heartbeat.interval}, uvw::TimerHandle::Time{heartbeat.interval});
+            }
+
+            void onHeartbeatTimer() {
+                if(state_ != 2) {
+                    heartbeat_pending_.clear();
+                    return;
+                }
+                if(input_paused_) {
+                    // Pongs wait undispatched with the rest of the input: the peer is not missing them
+                    return;
+                }
+                size_t max_missed = (config_.heartbeat.max_missed > 0) ? (size_t)config_.heartbeat.max_missed : 1;
+                if(heartbeat_pending_.size() >= max_missed) {
+                    onPeerDead();
+                    return;
+                }
+
+                uint32_t seq = ++heartbeat_seq_;
+                JsonWriter writer(config_.heartbeat.ping_type.length() + 48);
+                writer.raw("{\"type\":", 8);
+                writer.value(config_.heartbeat.ping_type);
+                writer.raw(",\"data\":", 8);
+                writer.beginObject();
+                writer.member("seq", seq);
+                writer.endObject();
+                writer.put('}');
+                writer.put(0x0c);
+
+                heartbeat_pending_.emplace_back(seq, HeartbeatClock::now());
+                heartbeat_sent_++;
+
+                size_t length = 0;
+                std::unique_ptr<char[]> frame = writer.release(length);
+                writeFrame(std::move(frame), length);
+            }
+
+            void onHeartbeatPing(IncomingMessage &message) {
+                // Echo the data back so the peer can match its own sequence number
+                JsonWriter writer(config_.heartbeat.pong_type.length() + (message.dataEnd() - message.dataBegin()) + 24);
+                writer.raw("{\"type\":", 8);
+                writer.value(config_.heartbeat.pong_type);
+                writer.raw(",\"data\":", 8);
+                writer.raw(message.dataBegin(), message.dataEnd() - message.dataBegin());
+                writer.put('}');
+                writer.put(0x0c);
+
+                size_t length = 0;
+                std::unique_ptr<char[]> frame = writer.release(length);
+                writeFrame(std::move(frame), length);
+            }
+
+            void onHeartbeatPong(IncomingMessage &message) {
+                JsonReader reader(message.dataBegin(), message.dataEnd());
+                std::string key;
+                uint32_t seq = 0;
+                bool has_seq = false;
+                if(reader.beginObject()) {
+                    while(reader.nextMember(key)) {
+                        if(key == "seq")
+                            has_seq = reader.read(seq);
+                        else
+                            reader.skip();
+                    }
+                }
+                if(!has_seq)
+                    return;
+
+                HeartbeatClock::time_point now = HeartbeatClock::now();
+                while(!heartbeat_pending_.empty() && (int32_t)(heartbeat_pending_.front().first - seq) <= 0) {
+                    if(heartbeat_pending_.front().first == seq) {
+                        uint64_t rtt_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - heartbeat_pending_.front().second).count();
+                        heartbeat_rtt_.add(rtt_us);
+                        heartbeat_received_++;
+                    }
+                    // Older pings are answered implicitly: the peer is alive
+                    heartbeat_pending_.pop_front();
+                }
+            }
+
+            void onPeerDead() {
+                int missed = (int)heartbeat_pending_.size();
+                heartbeat_pending_.clear();
+
+                HeartbeatTimeoutError err(missed);
+                bool flag_reconnect = true;
+                if(on_error_) {
+                    on_error_(err, flag_reconnect);
+                }
+                if(!flag_reconnect) {
+                    close();
+                    return;
+                }
+
+                state_ = 1;
+                dropPartialInput();
+                reconnectNow();
             }
+
+            // Drops the current connection and starts the next one
+            void reconnectNow() {
+                if(shm_link_) {
+                    shm_link_->close();
+                    connectToNet(conn_id_, conn_host_, conn_port_, connect_callback_);
+                }else if(transport_) {
+                    transport_->reconnect();
+                }
+            }
+
+            HeartbeatStats heartbeatStats() const override {
+                HeartbeatStats stats;
+                stats.sent = heartbeat_sent_;
+                stats.received = heartbeat_received_;
+                stats.outstanding = (uint32_t)heartbeat_pending_.size();
+                stats.samples = heartbeat_rtt_.count();
+                stats.last_ms = heartbeat_rtt_.last() / 1000.0;
+                stats.min_ms = heartbeat_rtt_.min() / 1000.0;
+                stats.mean_ms = heartbeat_rtt_.mean() / 1000.0;
+                stats.p50_ms = heartbeat_rtt_.percentile(0.5) / 1000.0;
+                stats.p99_ms = heartbeat_rtt_.percentile(0.99) / 1000.0;
+                stats.max_ms = heartbeat_rtt_.max() / 1000.0;
+                return stats;
+            }
+
+            void writeFrame(std::unique_ptr<char[]> buf, size_t length) {
+                if(capture_) {
+                    capture_->write(CAPTURE_OUTBOUND, buf.get(), length);
+                }
+                if(shm_link_) {
+                    shm_link_->write(std::move(buf), length);
+                }else if(transport_) {
+                    transport_->write(std::move(buf), length);
+                }
+            }
+
             IpcConfig &config() override {
                 return config_;
             }
@@ -190,28 +586,438 @@ namespace jcu {
 
             }
             void onMessage(const std::string &msg_type, const OnMessage_t& on_message) override {
-                DataHandlerList &handler_list = data_handlers_.typedRef(msg_type);
-                std::unique_ptr<NormalMessageCallbackHolder> holder(new NormalMessageCallbackHolder(on_message));
-                handler_list.emplace_back(std::move(holder));
+                onMessage(msg_type, on_message, MessageDispatchOptions());
             }
             void onMessage(const std::string &msg_type, const OnMessageWithType_t& on_message) override {
+                onMessage(msg_type, on_message, MessageDispatchOptions());
+            }
+            void onMessage(const std::string &msg_type, const OnMessage_t& on_message, const MessageDispatchOptions& options) override {
+                std::unique_ptr<MessageHandler> handler(new NormalMessageHandler(on_message));
+                addMessageHandler(msg_type, std::move(handler), options);
+            }
+            void onMessage(const std::string &msg_type, const OnMessageWithType_t& on_message, const MessageDispatchOptions& options) override {
+                std::unique_ptr<MessageHandler> handler(new WithTypeMessageHandler(on_message));
+                addMessageHandler(msg_type, std::move(handler), options);
+            }
+            void addMessageHandler(const std::string &msg_type, std::unique_ptr<MessageHandler> handler, const MessageDispatchOptions& options) override {
                 DataHandlerList &handler_list = data_handlers_.typedRef(msg_type);
-                std::unique_ptr<WithTypeMessageCallbackHolder> holder(new WithTypeMessageCallbackHolder(on_message));
+                std::unique_ptr<MessageCallbackHolder> holder(new MessageCallbackHolder(std::move(handler), options));
                 handler_list.emplace_back(std::move(holder));
             }
 
+            void waitConnected(Waiter *waiter) override {
+                connect_waiters_.push(waiter);
+            }
+            void waitMessage(const std::string &msg_type, Waiter *waiter) override {
+                message_waiters_[msg_type].push(waiter);
+            }
+
+            void onDecodeError(const std::string& what) override {
+                if(utils::WorkerPool::isWorkerThread()) {
+                    // Offloaded handlers decode on a worker; on_error_ only ever runs on the loop thread
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    deferred_errors_.push_back(what);
+                    if(outbound_async_) {
+                        outbound_async_->send();
+                    }
+                    return;
+                }
+                reportDecodeError(what);
+            }
+
+            void reportDecodeError(const std::string& what) {
+                if(on_error_) {
+                    JsonParseError err(what);
+                    bool reconnect = false;
+                    on_error_(err, reconnect);
+                }
+            }
+
+            void reportDeferredErrors() {
+                std::deque<std::string> errors;
+                {
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    errors.swap(deferred_errors_);
+                }
+                for(auto it = errors.begin(); it != errors.end(); it++) {
+                    reportDecodeError(*it);
+                }
+            }
+
+            bool startCapture(const std::string& path) override {
+                capture_ = CaptureWriter::create(path);
+                return capture_ != nullptr;
+            }
+            void stopCapture() override {
+                capture_.reset();
+            }
+            void feed(const char *data, size_t length) override {
+                onReceive(data, length);
+                // Without a loop there is no wakeup to report worker errors from
+                if(!outbound_async_) {
+                    reportDeferredErrors();
+                }
+            }
+
+            void waitIdle() override {
+                if(worker_pool_) {
+                    worker_pool_->waitIdle();
+                }
+                if(!outbound_async_) {
+                    reportDeferredErrors();
+                }
+            }
+
+            void onTransportData(const char *data, size_t length) {
+                if(capture_) {
+                    capture_->write(CAPTURE_INBOUND, data, length);
+                }
+                onReceive(data, length);
+            }
+
+            /**
+             * The next connection starts a new stream: only an incomplete frame is dropped.
+             * Complete frames still waiting for the workers are dispatched on resumeInput().
+             */
+            void dropPartialInput() {
+                recv_buffer_.clear();
+                if(!input_paused_)
+                    return;
+                size_t last_delimiter = input_backlog_.rfind((char)0x0c);
+                if(last_delimiter == std::string::npos) {
+                    input_backlog_.clear();
+                }else{
+                    input_backlog_.resize(last_delimiter + 1);
+                }
+            }
+
+            void resetInput() {
+                recv_buffer_.clear();
+                input_paused_ = false;
+                input_backlog_.clear();
+            }
+
+            void pauseInput(const char *rest, size_t length) {
+                input_paused_ = true;
+                input_backlog_.assign(rest, length);
+                if(shm_link_) {
+                    shm_link_->pause();
+                }
+            }
+
+            /**
+             * The peer keeps sending faster than the workers drain: the buffered stream
+             * cannot be kept, so it is dropped and the connection starts over.
+             */
+            void onInputBacklogOverflow() {
+                InputBacklogOverflowError err(config_.input_backlog_limit);
+                bool flag_reconnect = true;
+                if(on_error_) {
+                    on_error_(err, flag_reconnect);
+                }
+                if(!flag_reconnect) {
+                    close();
+                    return;
+                }
+
+                if(state_ == 2) {
+                    state_ = 1;
+                }
+                heartbeat_pending_.clear();
+                resetInput();
+                reconnectNow();
+            }
+
+            void resumeInput() {
+                if(!input_paused_ || (worker_pool_ && worker_pool_->saturated()))
+                    return;
+                input_paused_ = false;
+                std::string backlog;
+                backlog.swap(input_backlog_);
+                onReceive(backlog.data(), backlog.length());
+                if(!input_paused_ && shm_link_) {
+                    shm_link_->resume();
+                }
+            }
+
+            void onReceive(const char *data, size_t length) {
+                if(input_paused_) {
+                    // Sockets cannot stop reading: keep the bytes for resumeInput()
+                    if(config_.input_backlog_limit && input_backlog_.length() + length > config_.input_backlog_limit) {
+                        onInputBacklogOverflow();
+                        return;
+                    }
+                    input_backlog_.append(data, length);
+                    return;
+                }
+                const char *end_ptr = data + length;
+                const char *frame_begin = data;
+                const char *delimiter;
+                while((delimiter = (const char *)memchr(frame_begin, 0x0c, end_ptr - frame_begin)) != nullptr) {
+                    if(recv_buffer_.empty()) {
+                        handleFrame(frame_begin, delimiter);
+                    }else{
+                        recv_buffer_.append(frame_begin, delimiter);
+                        handleFrame(recv_buffer_.data(), recv_buffer_.data() + recv_buffer_.length());
+                        recv_buffer_.clear();
+                    }
+                    frame_begin = delimiter + 1;
+                    if(worker_pool_ && worker_pool_->saturated()) {
+                        // Stop reading rather than blocking the loop; the pool wakes outbound_async_ when it drains
+                        if(outbound_async_) {
+                            pauseInput(frame_begin, end_ptr - frame_begin);
+                            return;
+                        }
+                        // Fed without a loop (replay): the caller's thread can wait
+                        worker_pool_->waitForSpace();
+                    }
+                }
+                recv_buffer_.append(frame_begin, end_ptr);
+            }
+
+            void handleFrame(const char *begin, const char *end) {
+                MessageFrame frame(begin, end, this);
+                std::string err_text;
+                if(!frame.decodeEnvelope(err_text)) {
+                    onDecodeError(err_text);
+                    return;
+                }
+                dispatchMessage(frame);
+            }
+
+            void dispatchMessage(MessageFrame& frame) {
+                const std::string &type = frame.type();
+                DataHandlerList *handler_list = data_handlers_.typedSearch(type);
+
+                bool has_offloaded = false;
+                if(handler_list) {
+                    for(auto it = handler_list->begin(); it != handler_list->end(); it++) {
+                        if((*it)->options_.offload) {
+                            has_offloaded = true;
+                        }else{
+                            (*it)->handler_->invoke(frame);
+                        }
+                    }
+                }
+
+                if(!message_waiters_.empty()) {
+                    auto waiters = message_waiters_.find(type);
+                    if(waiters != message_waiters_.end()) {
+                        waiters->second.completeAll(&frame);
+                    }
+                }
+
+                if(!has_offloaded)
+                    return;
+
+                if(!worker_pool_) {
+                    worker_pool_.reset(new utils::WorkerPool((config_.worker_threads > 0) ? config_.worker_threads : 0, config_.worker_queue_limit, [this]() -> void {
+                        std::unique_lock<std::mutex> lock(outbound_mutex_);
+                        if(outbound_async_) {
+                            outbound_async_->send();
+                        }
+                    }));
+                }
+
+                for(auto it = handler_list->begin(); it != handler_list->end(); it++) {
+                    MessageCallbackHolder *holder = it->get();
+                    if(!holder->options_.offload)
+                        continue;
+
+                    // The key needs the data; a frame that does not parse is not dispatched
+                    if(holder->options_.order_key && !frame.parseJson())
+                        continue;
+
+                    // Offloaded handlers share the frame bytes but each decodes its own data
+                    std::shared_ptr<MessageFrame> task_frame = frame.share();
+                    std::string key = holder->options_.order_key ? holder->options_.order_key(frame.json(), type) : type;
+                    if(holder->options_.conflate) {
+                        {
+                            std::unique_lock<std::mutex> lock(holder->conflate_mutex_);
+                            std::shared_ptr<MessageFrame> &pending = holder->conflate_pending_[key];
+                            bool queued = (pending != nullptr);
+                            pending = task_frame;
+                            if(queued)
+                                continue;
+                        }
+                        worker_pool_->submit(key, [holder, key]() -> void {
+                            std::shared_ptr<MessageFrame> latest;
+                            {
+                                std::unique_lock<std::mutex> lock(holder->conflate_mutex_);
+                                auto found = holder->conflate_pending_.find(key);
+                                latest = std::move(found->second);
+                                holder->conflate_pending_.erase(found);
+                            }
+                            holder->handler_->invoke(*latest);
+                        });
+                        continue;
+                    }
+                    worker_pool_->submit(key, [holder, task_frame]() -> void {
+                        holder->handler_->invoke(*task_frame);
+                    });
+                }
+            }
+
             void emit(const std::string& type, const Json::Value& data) override {
                 Json::FastWriter fast_writer;
-                Json::Value doc;
-                doc["type"] = type;
-                doc["data"] = data;
-
-                std::string output = fast_writer.write(doc);
-                size_t out_length = output.length();
-                std::unique_ptr<char[]> buf(new char[out_length + 1]);
-                memcpy(buf.get(), output.data(), output.length());
-                buf.get()[out_length] = 0x0c;
-                transport_->write(std::move(buf), out_length + 1);
+                fast_writer.omitEndingLineFeed();
+                std::string data_text = fast_writer.write(data);
+
+                // Envelope is written around the serialized data instead of copying data into a wrapper document
+                JsonWriter writer(type.length() + data_text.length() + 24);
+                writer.raw("{\"type\":", 8);
+                writer.value(type);
+                writer.raw(",\"data\":", 8);
+                writer.raw(data_text.data(), data_text.length());
+                writer.put('}');
+                writer.put(0x0c);
+
+                size_t length = 0;
+                std::unique_ptr<char[]> frame = writer.release(length);
+                const ConflationPolicy *policy = conflationPolicy(type);
+                // A typed policy has no key for Json data: not conflated rather than one key per type
+                if(policy && (policy->key_func || !policy->key_extractor)) {
+                    emitConflated([&]() -> std::string {
+                        return policy->key_func ? (type + '\0' + policy->key_func(data, type)) : type;
+                    }, std::move(frame), length);
+                    return;
+                }
+                emitFrame(std::move(frame), length);
+            }
+
+            void emitFrame(const std::string& type, std::unique_ptr<char[]> buf, size_t length) override {
+                const ConflationPolicy *policy = conflationPolicy(type);
+                // Pre-encoded frames are not decoded again for a key
+                if(policy && !policy->keyed()) {
+                    emitConflated([&]() -> std::string {
+                        return type;
+                    }, std::move(buf), length);
+                    return;
+                }
+                emitFrame(std::move(buf), length);
+            }
+
+            void emitFrame(const std::string& type, const std::string& key, std::unique_ptr<char[]> buf, size_t length) override {
+                const ConflationPolicy *policy = conflationPolicy(type);
+                if(policy) {
+                    emitConflated([&]() -> std::string {
+                        return policy->keyed() ? (type + '\0' + key) : type;
+                    }, std::move(buf), length);
+                    return;
+                }
+                emitFrame(std::move(buf), length);
+            }
+
+            void emitFrame(std::unique_ptr<char[]> buf, size_t length) override {
+                if(utils::WorkerPool::isWorkerThread()) {
+                    // Transports are not thread-safe: hand the frame over to the loop thread
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    if(outbound_async_) {
+                        outbound_queue_.emplace_back(std::move(buf), length);
+                        outbound_async_->send();
+                    }
+                    return;
+                }
+                writeFrame(std::move(buf), length);
+            }
+
+            void setConflation(const std::string& msg_type, ConflationKeyFunc_t key_func) override {
+                ConflationPolicy &policy = conflation_[msg_type];
+                policy.key_func = key_func;
+                policy.key_extractor.reset();
+            }
+
+            void setTypedConflation(const std::string& msg_type, std::shared_ptr<ConflationKeyExtractor> key_extractor) override {
+                ConflationPolicy &policy = conflation_[msg_type];
+                policy.key_func = nullptr;
+                policy.key_extractor = key_extractor;
+            }
+
+            const ConflationKeyExtractor *conflationKeyExtractor(const std::string& msg_type) const override {
+                const ConflationPolicy *policy = conflationPolicy(msg_type);
+                return policy ? policy->key_extractor.get() : nullptr;
+            }
+
+            const ConflationPolicy *conflationPolicy(const std::string& type) const {
+                if(conflation_.empty())
+                    return nullptr;
+                auto it = conflation_.find(type);
+                return (it != conflation_.end()) ? &it->second : nullptr;
+            }
+
+            bool backpressured() const {
+                return state_ != 2 || (shm_link_ && shm_link_->pendingBytes() > 0);
+            }
+
+            /**
+             * @param make_key called only when the frame is held back
+             */
+            template<typename MakeKey>
+            void emitConflated(const MakeKey& make_key, std::unique_ptr<char[]> buf, size_t length) {
+                bool on_worker = utils::WorkerPool::isWorkerThread();
+                if(!on_worker && !backpressured()) {
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    if(conflated_queue_.empty()) {
+                        lock.unlock();
+                        writeFrame(std::move(buf), length);
+                        return;
+                    }
+                }
+
+                std::string key = make_key();
+                {
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    auto found = conflated_index_.find(key);
+                    if(found != conflated_index_.end()) {
+                        // Keeps its place in the queue so a busy key is not starved
+                        found->second->frame = std::move(buf);
+                        found->second->length = length;
+                    }else{
+                        ConflatedFrame item;
+                        item.key = key;
+                        item.frame = std::move(buf);
+                        item.length = length;
+                        conflated_queue_.push_back(std::move(item));
+                        conflated_index_[key] = std::prev(conflated_queue_.end());
+                    }
+                    if(on_worker) {
+                        if(outbound_async_) {
+                            outbound_async_->send();
+                        }
+                        return;
+                    }
+                }
+                flushConflated();
+            }
+
+            void flushConflated() {
+                while(!backpressured()) {
+                    std::unique_ptr<char[]> frame;
+                    size_t length;
+                    {
+                        std::unique_lock<std::mutex> lock(outbound_mutex_);
+                        if(conflated_queue_.empty())
+                            return;
+                        ConflatedFrame &front = conflated_queue_.front();
+                        frame = std::move(front.frame);
+                        length = front.length;
+                        conflated_index_.erase(front.key);
+                        conflated_queue_.pop_front();
+                    }
+                    writeFrame(std::move(frame), length);
+                }
+            }
+
+            void flushOutbound() {
+                std::deque<std::pair<std::unique_ptr<char[]>, size_t>> frames;
+                {
+                    std::unique_lock<std::mutex> lock(outbound_mutex_);
+                    frames.swap(outbound_queue_);
+                }
+                for(auto it = frames.begin(); it != frames.end(); it++) {
+                    writeFrame(std::move(it->first), it->second);
+                }
+                flushConflated();
             }
 
             void reconnect() {
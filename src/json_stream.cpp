@@ -0,0 +1,684 @@
+/**
+ * @file	json_stream.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <jcu/node_ipc/json_stream.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <locale.h>
+
+namespace jcu {
+    namespace node_ipc {
+
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+
+        JsonWriter::JsonWriter(size_t initial_capacity)
+            : size_(0), capacity_(0), need_comma_(false) {
+            if(initial_capacity > 0)
+                grow(initial_capacity);
+        }
+
+        void JsonWriter::grow(size_t required) {
+            size_t capacity = capacity_ ? capacity_ : 64;
+            while(capacity < required)
+                capacity *= 2;
+            std::unique_ptr<char[]> buf(new char[capacity]);
+            if(size_)
+                memcpy(buf.get(), buf_.get(), size_);
+            buf_ = std::move(buf);
+            capacity_ = capacity;
+        }
+
+        void JsonWriter::raw(const char *data, size_t length) {
+            if(size_ + length > capacity_)
+                grow(size_ + length);
+            memcpy(buf_.get() + size_, data, length);
+            size_ += length;
+            need_comma_ = false;
+        }
+
+        void JsonWriter::beginObject() {
+            separator();
+            put('{');
+            need_comma_ = false;
+        }
+
+        void JsonWriter::endObject() {
+            put('}');
+            need_comma_ = true;
+        }
+
+        void JsonWriter::beginArray() {
+            separator();
+            put('[');
+            need_comma_ = false;
+        }
+
+        void JsonWriter::endArray() {
+            put(']');
+            need_comma_ = true;
+        }
+
+        void JsonWriter::key(const char *name, size_t length) {
+            separator();
+            need_comma_ = false;
+            value(name, length);
+            put(':');
+            need_comma_ = false;
+        }
+
+        void JsonWriter::valueNull() {
+            separator();
+            raw("null", 4);
+            need_comma_ = true;
+        }
+
+        void JsonWriter::value(bool v) {
+            separator();
+            if(v)
+                raw("true", 4);
+            else
+                raw("false", 5);
+            need_comma_ = true;
+        }
+
+        void JsonWriter::value(long long v) {
+            if(v < 0) {
+                separator();
+                put('-');
+                need_comma_ = false;
+                value((unsigned long long)0 - (unsigned long long)v);
+            }else{
+                value((unsigned long long)v);
+            }
+        }
+
+        void JsonWriter::value(unsigned long long v) {
+            char tmp[24];
+            char *p = tmp + sizeof(tmp);
+            do {
+                *--p = (char)('0' + (v % 10));
+                v /= 10;
+            } while(v);
+            separator();
+            raw(p, tmp + sizeof(tmp) - p);
+            need_comma_ = true;
+        }
+
+        /**
+         * snprintf and strtod follow LC_NUMERIC; JSON always uses '.'
+         * @return decimal point of the current locale, nullptr if it is '.'
+         */
+        static const char *localeDecimalPoint() {
+            const struct lconv *lc = localeconv();
+            if(!lc || !lc->decimal_point || !lc->decimal_point[0] ||
+               (lc->decimal_point[0] == '.' && !lc->decimal_point[1]))
+                return nullptr;
+            return lc->decimal_point;
+        }
+
+        void JsonWriter::value(double v) {
+            if(isnan(v) || isinf(v)) {
+                valueNull();
+                return;
+            }
+            char tmp[48];
+            int n = snprintf(tmp, sizeof(tmp), "%.17g", v);
+            const char *decimal_point = localeDecimalPoint();
+            if(decimal_point) {
+                char *p = strstr(tmp, decimal_point);
+                if(p) {
+                    size_t dp_length = strlen(decimal_point);
+                    *p = '.';
+                    memmove(p + 1, p + dp_length, (size_t)n - (p - tmp) - dp_length + 1);
+                    n -= (int)dp_length - 1;
+                }
+            }
+            separator();
+            raw(tmp, (size_t)n);
+            need_comma_ = true;
+        }
+
+        void JsonWriter::value(const char *str) {
+            value(str, ::strlen(str));
+        }
+
+        void JsonWriter::value(const char *str, size_t length) {
+            separator();
+            reserve(size_ + length + 2);
+            put('"');
+            const char *run = str;
+            const char *end = str + length;
+            for(const char *p = str; p != end; p++) {
+                unsigned char c = (unsigned char)*p;
+                if(c >= 0x20 && c != '"' && c != '\\')
+                    continue;
+                raw(run, p - run);
+                run = p + 1;
+                put('\\');
+                switch(c) {
+                    case '"': put('"'); break;
+                    case '\\': put('\\'); break;
+                    case '\b': put('b'); break;
+                    case '\f': put('f'); break;
+                    case '\n': put('n'); break;
+                    case '\r': put('r'); break;
+                    case '\t': put('t'); break;
+                    default:
+                        raw("u00", 3);
+                        put(HEX_DIGITS[c >> 4]);
+                        put(HEX_DIGITS[c & 0xf]);
+                        break;
+                }
+            }
+            raw(run, end - run);
+            put('"');
+            need_comma_ = true;
+        }
+
+        std::unique_ptr<char[]> JsonWriter::release(size_t& length) {
+            length = size_;
+            size_ = 0;
+            capacity_ = 0;
+            need_comma_ = false;
+            return std::move(buf_);
+        }
+
+        void JsonWriter::escapeString(std::string& out, const char *str, size_t length) {
+            JsonWriter writer(length + 8);
+            writer.value(str, length);
+            out.append(writer.data(), writer.size());
+        }
+
+        JsonReader::JsonReader(const char *begin, const char *end)
+            : cur_(begin), end_(end), first_(false), failed_(false) {
+        }
+
+        bool JsonReader::fail() {
+            failed_ = true;
+            cur_ = end_;
+            return false;
+        }
+
+        void JsonReader::skipWhitespace() {
+            while(cur_ != end_ && (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r'))
+                cur_++;
+        }
+
+        bool JsonReader::expect(char c) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if(cur_ == end_ || *cur_ != c)
+                return fail();
+            cur_++;
+            return true;
+        }
+
+        bool JsonReader::beginObject() {
+            if(!expect('{'))
+                return false;
+            first_ = true;
+            return true;
+        }
+
+        bool JsonReader::nextMember(std::string& key) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if(cur_ == end_)
+                return fail();
+            if(*cur_ == '}') {
+                cur_++;
+                first_ = false;
+                return false;
+            }
+            if(!first_ && !expect(','))
+                return false;
+            first_ = false;
+            skipWhitespace();
+            key.clear();
+            if(!parseString(&key))
+                return false;
+            return expect(':');
+        }
+
+        bool JsonReader::beginArray() {
+            if(!expect('['))
+                return false;
+            first_ = true;
+            return true;
+        }
+
+        bool JsonReader::nextElement() {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if(cur_ == end_)
+                return fail();
+            if(*cur_ == ']') {
+                cur_++;
+                first_ = false;
+                return false;
+            }
+            if(!first_ && !expect(','))
+                return false;
+            first_ = false;
+            return true;
+        }
+
+        bool JsonReader::readNull() {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if((end_ - cur_) >= 4 && !memcmp(cur_, "null", 4)) {
+                cur_ += 4;
+                return true;
+            }
+            return false;
+        }
+
+        bool JsonReader::read(bool& v) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if((end_ - cur_) >= 4 && !memcmp(cur_, "true", 4)) {
+                cur_ += 4;
+                v = true;
+                return true;
+            }
+            if((end_ - cur_) >= 5 && !memcmp(cur_, "false", 5)) {
+                cur_ += 5;
+                v = false;
+                return true;
+            }
+            return fail();
+        }
+
+        static bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        bool JsonReader::parseNumber(const char **num_begin, const char **num_end, bool *integral) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            // -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+            const char *p = cur_;
+            if(p != end_ && *p == '-')
+                p++;
+            if(p == end_ || !isDigit(*p))
+                return fail();
+            if(*p == '0') {
+                p++;
+            }else{
+                while(p != end_ && isDigit(*p))
+                    p++;
+            }
+            *integral = true;
+            if(p != end_ && *p == '.') {
+                p++;
+                if(p == end_ || !isDigit(*p))
+                    return fail();
+                while(p != end_ && isDigit(*p))
+                    p++;
+                *integral = false;
+            }
+            if(p != end_ && (*p == 'e' || *p == 'E')) {
+                p++;
+                if(p != end_ && (*p == '+' || *p == '-'))
+                    p++;
+                if(p == end_ || !isDigit(*p))
+                    return fail();
+                while(p != end_ && isDigit(*p))
+                    p++;
+                *integral = false;
+            }
+            // A number must end at a separator, e.g. "1-2" and "01" are rejected
+            if(p != end_ && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+                return fail();
+            *num_begin = cur_;
+            *num_end = p;
+            cur_ = p;
+            return true;
+        }
+
+        static double parseDouble(const char *b, const char *e) {
+            const char *decimal_point = localeDecimalPoint();
+            if(decimal_point) {
+                // Validated number text: at most one '.'
+                std::string text(b, e);
+                size_t dot = text.find('.');
+                if(dot != std::string::npos)
+                    text.replace(dot, 1, decimal_point);
+                return strtod(text.c_str(), nullptr);
+            }
+            char tmp[64];
+            size_t length = e - b;
+            if(length < sizeof(tmp)) {
+                memcpy(tmp, b, length);
+                tmp[length] = 0;
+                return strtod(tmp, nullptr);
+            }
+            std::string text(b, e);
+            return strtod(text.c_str(), nullptr);
+        }
+
+        bool JsonReader::readSigned(long long& v, long long min_value, long long max_value) {
+            const char *b, *e;
+            bool integral;
+            if(!parseNumber(&b, &e, &integral))
+                return false;
+            bool negative = (*b == '-');
+            if(!integral) {
+                // Fractional or exponent form: accept when it is integral and in range
+                double d = parseDouble(b, e);
+                // min_value is -(max_value + 1), which is exact as a double
+                if(!(d >= (double)min_value && d < -(double)min_value) || d != floor(d))
+                    return fail();
+                long long t = (long long)d;
+                if(t < min_value || t > max_value)
+                    return fail();
+                v = t;
+                return true;
+            }
+            unsigned long long limit = negative ? ((unsigned long long)0 - (unsigned long long)min_value) : (unsigned long long)max_value;
+            unsigned long long acc = 0;
+            for(const char *p = negative ? b + 1 : b; p != e; p++) {
+                unsigned long long digit = (unsigned long long)(*p - '0');
+                if(acc > (limit - digit) / 10)
+                    return fail();
+                acc = acc * 10 + digit;
+            }
+            v = negative ? (long long)((unsigned long long)0 - acc) : (long long)acc;
+            return true;
+        }
+
+        bool JsonReader::readUnsigned(unsigned long long& v, unsigned long long max_value) {
+            const char *b, *e;
+            bool integral;
+            if(!parseNumber(&b, &e, &integral))
+                return false;
+            if(!integral) {
+                double d = parseDouble(b, e);
+                if(!(d >= 0.0 && d <= (double)max_value) || d != floor(d))
+                    return fail();
+                // (double)max_value may round up past the largest representable value
+                if(d >= 18446744073709551616.0)
+                    return fail();
+                unsigned long long t = (unsigned long long)d;
+                if(t > max_value)
+                    return fail();
+                v = t;
+                return true;
+            }
+            if(*b == '-') {
+                // Only "-0" is a non-negative integer
+                for(const char *p = b + 1; p != e; p++) {
+                    if(*p != '0')
+                        return fail();
+                }
+                v = 0;
+                return true;
+            }
+            unsigned long long acc = 0;
+            for(const char *p = b; p != e; p++) {
+                unsigned long long digit = (unsigned long long)(*p - '0');
+                if(acc > (max_value - digit) / 10)
+                    return fail();
+                acc = acc * 10 + digit;
+            }
+            v = acc;
+            return true;
+        }
+
+        bool JsonReader::read(short& v) {
+            long long t;
+            if(!readSigned(t, SHRT_MIN, SHRT_MAX))
+                return false;
+            v = (short)t;
+            return true;
+        }
+
+        bool JsonReader::read(unsigned short& v) {
+            unsigned long long t;
+            if(!readUnsigned(t, USHRT_MAX))
+                return false;
+            v = (unsigned short)t;
+            return true;
+        }
+
+        bool JsonReader::read(int& v) {
+            long long t;
+            if(!readSigned(t, INT_MIN, INT_MAX))
+                return false;
+            v = (int)t;
+            return true;
+        }
+
+        bool JsonReader::read(unsigned int& v) {
+            unsigned long long t;
+            if(!readUnsigned(t, UINT_MAX))
+                return false;
+            v = (unsigned int)t;
+            return true;
+        }
+
+        bool JsonReader::read(long& v) {
+            long long t;
+            if(!readSigned(t, LONG_MIN, LONG_MAX))
+                return false;
+            v = (long)t;
+            return true;
+        }
+
+        bool JsonReader::read(unsigned long& v) {
+            unsigned long long t;
+            if(!readUnsigned(t, ULONG_MAX))
+                return false;
+            v = (unsigned long)t;
+            return true;
+        }
+
+        bool JsonReader::read(long long& v) {
+            return readSigned(v, LLONG_MIN, LLONG_MAX);
+        }
+
+        bool JsonReader::read(unsigned long long& v) {
+            return readUnsigned(v, ULLONG_MAX);
+        }
+
+        bool JsonReader::read(double& v) {
+            const char *b, *e;
+            bool integral;
+            if(!parseNumber(&b, &e, &integral))
+                return false;
+            v = parseDouble(b, e);
+            return true;
+        }
+
+        bool JsonReader::read(float& v) {
+            double d;
+            if(!read(d))
+                return false;
+            v = (float)d;
+            return true;
+        }
+
+        bool JsonReader::read(std::string& v) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            v.clear();
+            return parseString(&v);
+        }
+
+        static int hexValue(char c) {
+            if(c >= '0' && c <= '9') return c - '0';
+            if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t cp) {
+            if(cp < 0x80) {
+                out.push_back((char)cp);
+            }else if(cp < 0x800) {
+                out.push_back((char)(0xc0 | (cp >> 6)));
+                out.push_back((char)(0x80 | (cp & 0x3f)));
+            }else if(cp < 0x10000) {
+                out.push_back((char)(0xe0 | (cp >> 12)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+                out.push_back((char)(0x80 | (cp & 0x3f)));
+            }else{
+                out.push_back((char)(0xf0 | (cp >> 18)));
+                out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+                out.push_back((char)(0x80 | (cp & 0x3f)));
+            }
+        }
+
+        bool JsonReader::parseString(std::string* out) {
+            if(cur_ == end_ || *cur_ != '"')
+                return fail();
+            cur_++;
+            const char *run = cur_;
+            while(cur_ != end_) {
+                char c = *cur_;
+                if(c == '"') {
+                    if(out)
+                        out->append(run, cur_ - run);
+                    cur_++;
+                    return true;
+                }
+                if(c != '\\') {
+                    // Control characters must be escaped
+                    if((unsigned char)c < 0x20)
+                        return fail();
+                    cur_++;
+                    continue;
+                }
+                if(out)
+                    out->append(run, cur_ - run);
+                cur_++;
+                if(cur_ == end_)
+                    return fail();
+                c = *cur_++;
+                if(c == 'u') {
+                    uint32_t cp = 0;
+                    for(int i = 0; i < 4; i++) {
+                        int h = (cur_ != end_) ? hexValue(*cur_++) : -1;
+                        if(h < 0)
+                            return fail();
+                        cp = (cp << 4) | (uint32_t)h;
+                    }
+                    if(cp >= 0xd800 && cp < 0xdc00 && (end_ - cur_) >= 6 && cur_[0] == '\\' && cur_[1] == 'u') {
+                        uint32_t lo = 0;
+                        bool valid = true;
+                        for(int i = 0; i < 4; i++) {
+                            int h = hexValue(cur_[2 + i]);
+                            if(h < 0) {
+                                valid = false;
+                                break;
+                            }
+                            lo = (lo << 4) | (uint32_t)h;
+                        }
+                        if(valid && lo >= 0xdc00 && lo < 0xe000) {
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                            cur_ += 6;
+                        }
+                    }
+                    if(out)
+                        appendUtf8(*out, cp);
+                }else{
+                    switch(c) {
+                        case 'b': c = '\b'; break;
+                        case 'f': c = '\f'; break;
+                        case 'n': c = '\n'; break;
+                        case 'r': c = '\r'; break;
+                        case 't': c = '\t'; break;
+                        case '"':
+                        case '\\':
+                        case '/':
+                            break;
+                        default:
+                            return fail();
+                    }
+                    if(out)
+                        out->push_back(c);
+                }
+                run = cur_;
+            }
+            return fail();
+        }
+
+        bool JsonReader::skip() {
+            const char *b, *e;
+            return skip(&b, &e);
+        }
+
+        bool JsonReader::skip(const char **value_begin, const char **value_end) {
+            if(failed_)
+                return false;
+            skipWhitespace();
+            if(cur_ == end_)
+                return fail();
+            *value_begin = cur_;
+
+            // Open brackets, to reject "[}" style mismatches
+            std::string nesting;
+            do {
+                skipWhitespace();
+                if(cur_ == end_)
+                    return fail();
+                char c = *cur_;
+                if(c == '"') {
+                    if(!parseString(nullptr))
+                        return false;
+                }else if(c == '{' || c == '[') {
+                    nesting.push_back(c);
+                    cur_++;
+                }else if(c == '}' || c == ']') {
+                    if(nesting.empty() || nesting.back() != ((c == '}') ? '{' : '['))
+                        return fail();
+                    nesting.pop_back();
+                    cur_++;
+                }else if(c == ',' || c == ':') {
+                    if(nesting.empty())
+                        return fail();
+                    cur_++;
+                }else if(c == 't') {
+                    if((end_ - cur_) < 4 || memcmp(cur_, "true", 4))
+                        return fail();
+                    cur_ += 4;
+                }else if(c == 'f') {
+                    if((end_ - cur_) < 5 || memcmp(cur_, "false", 5))
+                        return fail();
+                    cur_ += 5;
+                }else if(c == 'n') {
+                    if((end_ - cur_) < 4 || memcmp(cur_, "null", 4))
+                        return fail();
+                    cur_ += 4;
+                }else{
+                    const char *b, *e;
+                    bool integral;
+                    if(!parseNumber(&b, &e, &integral))
+                        return false;
+                }
+            } while(!nesting.empty());
+
+            *value_end = cur_;
+            return true;
+        }
+
+    }
+}
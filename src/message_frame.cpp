@@ -0,0 +1,104 @@
+/**
+ * @file	message_frame.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "message_frame.h"
+
+#include <jcu/node_ipc/json_stream.h>
+
+#include <json/json.h>
+
+namespace jcu {
+    namespace node_ipc {
+
+        static const char NULL_TEXT[] = "null";
+
+        MessageFrame::MessageFrame(const char *begin, const char *end, DecodeErrorSink *error_sink)
+            : begin_(begin), end_(end),
+              data_begin_(NULL_TEXT), data_end_(NULL_TEXT + 4),
+              parsed_(false), parse_ok_(false), error_sink_(error_sink) {
+        }
+
+        bool MessageFrame::decodeEnvelope(std::string& err_text) {
+            JsonReader reader(begin_, end_);
+            std::string key;
+            bool has_type = false;
+            if(reader.beginObject()) {
+                while(reader.nextMember(key)) {
+                    if(key == "type") {
+                        has_type = reader.read(type_);
+                    }else if(key == "data") {
+                        reader.skip(&data_begin_, &data_end_);
+                    }else{
+                        reader.skip();
+                    }
+                }
+            }
+            if(!reader.ok()) {
+                err_text = "malformed message frame";
+                return false;
+            }
+            if(!has_type) {
+                err_text = "message frame without type";
+                return false;
+            }
+            return true;
+        }
+
+        std::shared_ptr<MessageFrame> MessageFrame::share() {
+            if(!owned_) {
+                std::shared_ptr<const std::string> owned(new std::string(begin_, end_));
+                const char *base = owned->data();
+                if(data_begin_ != NULL_TEXT) {
+                    data_begin_ = base + (data_begin_ - begin_);
+                    data_end_ = base + (data_end_ - begin_);
+                }
+                begin_ = base;
+                end_ = base + owned->length();
+                owned_ = owned;
+            }
+            std::shared_ptr<MessageFrame> frame(new MessageFrame(begin_, end_, error_sink_));
+            frame->owned_ = owned_;
+            frame->type_ = type_;
+            frame->data_begin_ = data_begin_;
+            frame->data_end_ = data_end_;
+            return frame;
+        }
+
+        bool MessageFrame::parseJson() {
+            if(!parsed_) {
+                // CharReader is not thread-safe; offloaded handlers parse on worker threads
+                static thread_local std::unique_ptr<Json::CharReader> reader;
+                if(!reader) {
+                    Json::CharReaderBuilder reader_builder;
+                    reader.reset(reader_builder.newCharReader());
+                }
+                std::string err_text;
+                parsed_ = true;
+                parse_ok_ = reader->parse(data_begin_, data_end_, &json_, &err_text);
+                if(!parse_ok_) {
+                    json_ = Json::Value();
+                    decodeFailed(err_text);
+                }
+            }
+            return parse_ok_;
+        }
+
+        Json::Value& MessageFrame::json() {
+            parseJson();
+            return json_;
+        }
+
+        void MessageFrame::decodeFailed(const std::string& what) {
+            if(error_sink_) {
+                error_sink_->onDecodeError(what);
+            }
+        }
+
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file	message_frame.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __SRC_MESSAGE_FRAME_H__
+#define __SRC_MESSAGE_FRAME_H__
+
+#include <jcu/node_ipc/instance.h>
+
+#include <string>
+#include <memory>
+
+#include <json/value.h>
+
+namespace jcu {
+    namespace node_ipc {
+
+        class DecodeErrorSink {
+        public:
+            virtual void onDecodeError(const std::string& what) = 0;
+        };
+
+        /**
+         * One {"type": ..., "data": ...} frame.
+         * The envelope is scanned without building a DOM; the data member is only
+         * parsed into a Json::Value when a handler asks for it.
+         */
+        class MessageFrame : public IncomingMessage {
+        private:
+            // Set when the frame owns its bytes (shared between offloaded handlers)
+            std::shared_ptr<const std::string> owned_;
+            const char *begin_;
+            const char *end_;
+
+            std::string type_;
+            const char *data_begin_;
+            const char *data_end_;
+
+            bool parsed_;
+            bool parse_ok_;
+            Json::Value json_;
+
+            DecodeErrorSink *error_sink_;
+
+        public:
+            /**
+             * @param begin frame text, without the delimiter. Must outlive the frame unless share() is used.
+             * @param end
+             */
+            MessageFrame(const char *begin, const char *end, DecodeErrorSink *error_sink);
+
+            /**
+             * Scan the envelope for the type and data members
+             * @param err_text error description on failure
+             * @return True on success
+             */
+            bool decodeEnvelope(std::string& err_text);
+
+            /**
+             * Create an independent frame owning a copy of the bytes (copied at most once)
+             * with its own DOM, safe to hand to another thread
+             */
+            std::shared_ptr<MessageFrame> share();
+
+            const std::string& type() const override {
+                return type_;
+            }
+            const char *dataBegin() const override {
+                return data_begin_;
+            }
+            const char *dataEnd() const override {
+                return data_end_;
+            }
+            bool parseJson() override;
+            Json::Value& json() override;
+            void decodeFailed(const std::string& what) override;
+        };
+
+    }
+}
+
+#endif // __SRC_MESSAGE_FRAME_H__
@@ -0,0 +1,186 @@
+/**
+ * @file	shm_link.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "shm_link.h"
+
+namespace jcu {
+    namespace node_ipc {
+
+        // The waiter re-checks for shutdown and peer liveness at this interval
+        static const int SHM_WAIT_TIMEOUT_MS = 100;
+
+        ShmLink::ShmLink(std::shared_ptr<uvw::Loop> loop, std::unique_ptr<ShmRing> ring)
+            : loop_(loop), ring_(std::move(ring)), closed_(false), paused_(false), write_blocked_(false),
+              drain_pending_(false), stopping_(false), pending_offset_(0), pending_bytes_(0) {
+        }
+
+        ShmLink::~ShmLink() {
+            close();
+        }
+
+        void ShmLink::start(DataCallback_t on_data, CloseCallback_t on_close) {
+            on_data_ = on_data;
+            on_close_ = on_close;
+
+            async_ = loop_->resource<uvw::AsyncHandle>();
+            async_->on<uvw::AsyncEvent>([this](uvw::AsyncEvent &evt, uvw::AsyncHandle &handle) -> void {
+                flush();
+                drain();
+            });
+
+            waiter_ = std::thread(&ShmLink::waiterMain, this);
+        }
+
+        void ShmLink::close() {
+            if(closed_)
+                return;
+            closed_ = true;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            if(ring_) {
+                ring_->interrupt();
+            }
+            if(waiter_.joinable()) {
+                waiter_.join();
+            }
+            if(ring_) {
+                ring_->close();
+            }
+
+            if(async_) {
+                async_->close();
+                async_.reset();
+            }
+            pending_.clear();
+            pending_bytes_ = 0;
+        }
+
+        void ShmLink::waiterMain() {
+            for(;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if(stopping_)
+                        break;
+                }
+                // Read before the flags, so a change signalled through interrupt() is not missed
+                uint32_t seq = ring_->eventSeq();
+                bool closed = ring_->isClosed();
+                if(!closed) {
+                    int events = (paused_ ? 0 : ShmRing::READABLE) | (write_blocked_ ? ShmRing::WRITABLE : 0);
+                    if(!ring_->waitEvent(events, seq, SHM_WAIT_TIMEOUT_MS)) {
+                        // A peer that crashed never sets the closed flag
+                        if(ring_->eventSeq() == seq && !ring_->peerAlive())
+                            ring_->close();
+                        continue;
+                    }
+                }
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                if(stopping_)
+                    break;
+                drain_pending_ = true;
+                async_->send();
+                cv_.wait(lock, [this]() -> bool {
+                    return !drain_pending_ || stopping_;
+                });
+                if(closed)
+                    break;
+            }
+        }
+
+        void ShmLink::drain() {
+            const char *data;
+            size_t length;
+            while(!closed_ && !paused_ && (length = ring_->peek(&data)) > 0) {
+                on_data_(data, length);
+                if(closed_)
+                    return;
+                ring_->consume(length);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                drain_pending_ = false;
+            }
+            cv_.notify_all();
+
+            // Data the peer wrote before closing is delivered on resume()
+            if(!closed_ && !paused_ && ring_->isClosed()) {
+                CloseCallback_t on_close = on_close_;
+                close();
+                if(on_close) {
+                    on_close();
+                }
+            }
+        }
+
+        void ShmLink::pause() {
+            paused_ = true;
+        }
+
+        void ShmLink::resume() {
+            if(!paused_)
+                return;
+            paused_ = false;
+            if(!closed_) {
+                // The waiter left READABLE out while paused
+                ring_->interrupt();
+                drain();
+            }
+        }
+
+        void ShmLink::write(std::unique_ptr<char[]> data, size_t length) {
+            if(closed_)
+                return;
+            size_t written = 0;
+            if(pending_.empty()) {
+                written = ring_->write(data.get(), length);
+                if(written == length)
+                    return;
+            }
+            if(pending_.empty()) {
+                pending_offset_ = written;
+            }
+            pending_bytes_ += length - written;
+            pending_.emplace_back(std::move(data), length);
+
+            if(!write_blocked_) {
+                // Have the waiter sleep on WRITABLE as well
+                write_blocked_ = true;
+                ring_->interrupt();
+            }
+        }
+
+        void ShmLink::flush() {
+            while(!pending_.empty() && !closed_) {
+                std::pair<std::unique_ptr<char[]>, size_t>& front = pending_.front();
+                size_t remaining = front.second - pending_offset_;
+                size_t written = ring_->write(front.first.get() + pending_offset_, remaining);
+                pending_bytes_ -= written;
+                if(written < remaining) {
+                    pending_offset_ += written;
+                    return;
+                }
+                pending_.pop_front();
+                pending_offset_ = 0;
+            }
+            if(write_blocked_ && !closed_) {
+                write_blocked_ = false;
+                if(on_drain_) {
+                    on_drain_();
+                }
+            }
+        }
+
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * @file	shm_link.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __SRC_SHM_LINK_H__
+#define __SRC_SHM_LINK_H__
+
+#include <jcu/node_ipc/shm_ring.h>
+
+#include <memory>
+#include <functional>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <uvw/loop.hpp>
+#include <uvw/async.hpp>
+
+namespace jcu {
+    namespace node_ipc {
+
+        /**
+         * Drives a ShmRing from a uvw loop.
+         *
+         * A helper thread sleeps on the ring's futex and wakes the loop through an async
+         * handle; incoming bytes are handed to the data callback straight from the ring.
+         * Writes that do not fit are kept, and the helper thread also waits for the peer to
+         * free space while any are pending.
+         */
+        class ShmLink {
+        public:
+            typedef std::function<void(const char *data, size_t length)> DataCallback_t;
+            typedef std::function<void()> CloseCallback_t;
+            typedef std::function<void()> DrainCallback_t;
+
+            ShmLink(std::shared_ptr<uvw::Loop> loop, std::unique_ptr<ShmRing> ring);
+            ~ShmLink();
+
+            void start(DataCallback_t on_data, CloseCallback_t on_close);
+            void write(std::unique_ptr<char[]> data, size_t length);
+            void close();
+
+            /**
+             * Stop consuming the ring, so a fast peer blocks on a full ring instead of the
+             * data piling up in this process. Call on the loop thread.
+             */
+            void pause();
+
+            /**
+             * Consume the ring again, delivering whatever arrived while paused
+             */
+            void resume();
+
+            /**
+             * Called on the loop thread when writes kept back by a full ring have all been
+             * copied into it
+             */
+            void onDrain(DrainCallback_t on_drain) {
+                on_drain_ = on_drain;
+            }
+
+            /**
+             * @return bytes accepted by write() but not yet copied into the ring
+             */
+            size_t pendingBytes() const {
+                return pending_bytes_;
+            }
+
+        private:
+            std::shared_ptr<uvw::Loop> loop_;
+            std::unique_ptr<ShmRing> ring_;
+
+            std::shared_ptr<uvw::AsyncHandle> async_;
+
+            DataCallback_t on_data_;
+            CloseCallback_t on_close_;
+            DrainCallback_t on_drain_;
+            bool closed_;
+
+            // Select the events the waiter sleeps on; changed on the loop thread
+            std::atomic<bool> paused_;
+            std::atomic<bool> write_blocked_;
+
+            std::thread waiter_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool drain_pending_;
+            bool stopping_;
+
+            std::deque<std::pair<std::unique_ptr<char[]>, size_t>> pending_;
+            size_t pending_offset_;
+            size_t pending_bytes_;
+
+            void waiterMain();
+            void drain();
+            void flush();
+        };
+
+    }
+}
+
+#endif // __SRC_SHM_LINK_H__
@@ -0,0 +1,379 @@
+/**
+ * @file	shm_ring.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <jcu/node_ipc/shm_ring.h>
+
+#if defined(__linux__)
+
+#include <atomic>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace jcu {
+    namespace node_ipc {
+
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                      "shared memory rings need address-free atomics");
+
+        static const uint32_t SHM_RING_MAGIC = 0x4a4e4952; // "JNIR"
+        static const uint32_t SHM_RING_VERSION = 2;
+
+        struct alignas(64) ShmQueue {
+            // Total bytes written by the producer
+            alignas(64) std::atomic<uint64_t> head;
+            // Total bytes released by the consumer
+            alignas(64) std::atomic<uint64_t> tail;
+        };
+
+        // Futex word of one endpoint, bumped by the peer when it may proceed
+        struct alignas(64) ShmDoorbell {
+            std::atomic<uint32_t> seq;
+            // READABLE / WRITABLE events the endpoint is sleeping on
+            std::atomic<uint32_t> waiting;
+        };
+
+        struct alignas(64) ShmControl {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t ring_size;
+            std::atomic<uint32_t> client_attached;
+            std::atomic<uint32_t> closed;
+
+            // Liveness of each side: pid and process start time, so a reused pid is not mistaken for the peer
+            std::atomic<int32_t> server_pid;
+            std::atomic<uint64_t> server_start;
+            std::atomic<int32_t> client_pid;
+            std::atomic<uint64_t> client_start;
+
+            ShmDoorbell server_bell;
+            ShmDoorbell client_bell;
+        };
+
+        // [ShmControl][ShmQueue client->server][ShmQueue server->client][ring c2s][ring s2c]
+        static size_t segmentSize(size_t ring_size) {
+            return sizeof(ShmControl) + sizeof(ShmQueue) * 2 + ring_size * 2;
+        }
+
+        static void futexWait(std::atomic<uint32_t> *word, uint32_t expected, int timeout_ms) {
+            struct timespec ts;
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+            syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, (timeout_ms >= 0) ? &ts : nullptr, nullptr, 0);
+        }
+
+        static void futexWakeAll(std::atomic<uint32_t> *word) {
+            syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+
+        static void ring(ShmDoorbell *bell) {
+            bell->seq.fetch_add(1);
+            futexWakeAll(&bell->seq);
+        }
+
+        /**
+         * @return start time of the process in clock ticks since boot, 0 if unknown
+         */
+        static uint64_t processStartTime(pid_t pid) {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+            FILE *fp = fopen(path, "r");
+            if(!fp)
+                return 0;
+            char buf[1024];
+            size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+            fclose(fp);
+            buf[n] = 0;
+            // Fields after the command name, which may itself contain spaces and parentheses
+            const char *p = strrchr(buf, ')');
+            if(!p)
+                return 0;
+            // starttime is field 22; the text after ')' starts at field 3
+            for(int field = 2; field < 22 && p; field++) {
+                p = strchr(p + 1, ' ');
+            }
+            return p ? strtoull(p + 1, nullptr, 10) : 0;
+        }
+
+        static bool processAlive(int32_t pid, uint64_t start_time) {
+            if(pid <= 0)
+                return false;
+            if(kill((pid_t)pid, 0) != 0 && errno == ESRCH)
+                return false;
+            uint64_t current = processStartTime((pid_t)pid);
+            return !(start_time && current && current != start_time);
+        }
+
+        class ShmRingImpl : public ShmRing {
+        private:
+            std::string name_;
+            bool owner_;
+            void *base_;
+            size_t mapped_size_;
+
+            ShmControl *control_;
+            ShmQueue *tx_queue_;
+            ShmQueue *rx_queue_;
+            ShmDoorbell *own_bell_;
+            ShmDoorbell *peer_bell_;
+            char *tx_data_;
+            char *rx_data_;
+            uint64_t mask_;
+
+        public:
+            ShmRingImpl(const std::string& name, bool owner, void *base, size_t mapped_size)
+                : name_(name), owner_(owner), base_(base), mapped_size_(mapped_size) {
+                char *p = (char *)base;
+                control_ = (ShmControl *)p;
+                ShmQueue *c2s = (ShmQueue *)(p + sizeof(ShmControl));
+                ShmQueue *s2c = c2s + 1;
+                char *c2s_data = (char *)(s2c + 1);
+                char *s2c_data = c2s_data + control_->ring_size;
+                mask_ = control_->ring_size - 1;
+                if(owner) {
+                    tx_queue_ = s2c;
+                    rx_queue_ = c2s;
+                    tx_data_ = s2c_data;
+                    rx_data_ = c2s_data;
+                    own_bell_ = &control_->server_bell;
+                    peer_bell_ = &control_->client_bell;
+                }else{
+                    tx_queue_ = c2s;
+                    rx_queue_ = s2c;
+                    tx_data_ = c2s_data;
+                    rx_data_ = s2c_data;
+                    own_bell_ = &control_->client_bell;
+                    peer_bell_ = &control_->server_bell;
+                }
+            }
+
+            ~ShmRingImpl() override {
+                close();
+                munmap(base_, mapped_size_);
+                if(owner_) {
+                    shm_unlink(name_.c_str());
+                }
+            }
+
+            size_t write(const char *data, size_t length) override {
+                ShmQueue *q = tx_queue_;
+                uint64_t head = q->head.load(std::memory_order_relaxed);
+                uint64_t tail = q->tail.load(std::memory_order_acquire);
+                size_t free_size = (size_t)(control_->ring_size - (head - tail));
+                size_t n = (length < free_size) ? length : free_size;
+                if(n == 0)
+                    return 0;
+
+                size_t offset = (size_t)(head & mask_);
+                size_t first = (size_t)control_->ring_size - offset;
+                if(first > n)
+                    first = n;
+                memcpy(tx_data_ + offset, data, first);
+                memcpy(tx_data_, data + first, n - first);
+                q->head.store(head + n, std::memory_order_release);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if(peer_bell_->waiting.load(std::memory_order_relaxed) & READABLE) {
+                    ring(peer_bell_);
+                }
+                return n;
+            }
+
+            size_t peek(const char **data) override {
+                ShmQueue *q = rx_queue_;
+                uint64_t tail = q->tail.load(std::memory_order_relaxed);
+                uint64_t head = q->head.load(std::memory_order_acquire);
+                size_t available = (size_t)(head - tail);
+                size_t offset = (size_t)(tail & mask_);
+                size_t contiguous = (size_t)control_->ring_size - offset;
+                *data = rx_data_ + offset;
+                return (available < contiguous) ? available : contiguous;
+            }
+
+            void consume(size_t length) override {
+                ShmQueue *q = rx_queue_;
+                q->tail.store(q->tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if(peer_bell_->waiting.load(std::memory_order_relaxed) & WRITABLE) {
+                    ring(peer_bell_);
+                }
+            }
+
+            size_t readable() const override {
+                return (size_t)(rx_queue_->head.load(std::memory_order_acquire) - rx_queue_->tail.load(std::memory_order_relaxed));
+            }
+
+            size_t writable() const override {
+                return (size_t)(control_->ring_size - (tx_queue_->head.load(std::memory_order_relaxed) - tx_queue_->tail.load(std::memory_order_acquire)));
+            }
+
+            int readyEvents(int events) const {
+                int ready = 0;
+                if((events & READABLE) && readable() > 0)
+                    ready |= READABLE;
+                if((events & WRITABLE) && writable() > 0)
+                    ready |= WRITABLE;
+                return ready;
+            }
+
+            uint32_t eventSeq() const override {
+                return own_bell_->seq.load();
+            }
+
+            int waitEvent(int events, uint32_t seq, int timeout_ms) override {
+                own_bell_->waiting.store((uint32_t)events);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int ready = readyEvents(events);
+                if(!ready && !isClosed()) {
+                    futexWait(&own_bell_->seq, seq, timeout_ms);
+                    ready = readyEvents(events);
+                }
+                own_bell_->waiting.store(0);
+                return ready;
+            }
+
+            bool waitReadable(int timeout_ms) override {
+                return waitEvent(READABLE, eventSeq(), timeout_ms) != 0;
+            }
+
+            bool waitWritable(int timeout_ms) override {
+                return waitEvent(WRITABLE, eventSeq(), timeout_ms) != 0;
+            }
+
+            void interrupt() override {
+                ring(own_bell_);
+            }
+
+            void close() override {
+                if(control_->closed.exchange(1) == 0) {
+                    // Wake both sides so they observe the close
+                    ring(own_bell_);
+                    ring(peer_bell_);
+                }
+            }
+
+            bool peerAlive() const override {
+                if(owner_) {
+                    // No client yet counts as alive
+                    int32_t pid = control_->client_pid.load();
+                    return !pid || processAlive(pid, control_->client_start.load());
+                }
+                return processAlive(control_->server_pid.load(), control_->server_start.load());
+            }
+
+            bool isClosed() const override {
+                return control_->closed.load() != 0;
+            }
+        };
+
+        std::unique_ptr<ShmRing> ShmRing::create(const std::string& name, size_t ring_size) {
+            size_t size = 4096;
+            while(size < ring_size)
+                size <<= 1;
+            size_t mapped_size = segmentSize(size);
+
+            shm_unlink(name.c_str());
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if(fd < 0)
+                return nullptr;
+            if(ftruncate(fd, (off_t)mapped_size) != 0) {
+                ::close(fd);
+                shm_unlink(name.c_str());
+                return nullptr;
+            }
+            void *base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(base == MAP_FAILED) {
+                shm_unlink(name.c_str());
+                return nullptr;
+            }
+
+            // ftruncate zero-fills, which is the initial state of every counter
+            ShmControl *control = (ShmControl *)base;
+            control->ring_size = size;
+            control->version = SHM_RING_VERSION;
+            control->server_pid.store((int32_t)getpid());
+            control->server_start.store(processStartTime(getpid()));
+            std::atomic_thread_fence(std::memory_order_release);
+            control->magic = SHM_RING_MAGIC;
+
+            return std::unique_ptr<ShmRing>(new ShmRingImpl(name, true, base, mapped_size));
+        }
+
+        std::unique_ptr<ShmRing> ShmRing::open(const std::string& name) {
+            int fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if(fd < 0)
+                return nullptr;
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmControl)) {
+                ::close(fd);
+                return nullptr;
+            }
+            size_t mapped_size = (size_t)st.st_size;
+            void *base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(base == MAP_FAILED)
+                return nullptr;
+
+            ShmControl *control = (ShmControl *)base;
+            if(control->magic != SHM_RING_MAGIC || control->version != SHM_RING_VERSION ||
+               segmentSize((size_t)control->ring_size) != mapped_size ||
+               control->closed.load() != 0) {
+                munmap(base, mapped_size);
+                return nullptr;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(!processAlive(control->server_pid.load(), control->server_start.load())) {
+                // Left behind by a server that died without closing it
+                munmap(base, mapped_size);
+                shm_unlink(name.c_str());
+                return nullptr;
+            }
+            uint32_t expected = 0;
+            if(!control->client_attached.compare_exchange_strong(expected, 1)) {
+                munmap(base, mapped_size);
+                return nullptr;
+            }
+            control->client_start.store(processStartTime(getpid()));
+            control->client_pid.store((int32_t)getpid());
+
+            return std::unique_ptr<ShmRing>(new ShmRingImpl(name, false, base, mapped_size));
+        }
+
+    }
+}
+
+#else
+
+namespace jcu {
+    namespace node_ipc {
+
+        std::unique_ptr<ShmRing> ShmRing::create(const std::string& name, size_t ring_size) {
+            return nullptr;
+        }
+
+        std::unique_ptr<ShmRing> ShmRing::open(const std::string& name) {
+            return nullptr;
+        }
+
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file	rtt_histogram.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "rtt_histogram.h"
+
+#include <math.h>
+
+namespace jcu {
+    namespace node_ipc {
+        namespace utils {
+
+            static int highestBit(uint64_t value) {
+#if defined(__GNUC__)
+                return 63 - __builtin_clzll(value);
+#else
+                int bit = 0;
+                while(value >>= 1)
+                    bit++;
+                return bit;
+#endif
+            }
+
+            RttHistogram::RttHistogram(size_t window)
+                : window_(window ? window : 1), next_(0), count_(0), sum_(0), last_(0), buckets_(BUCKET_COUNT) {
+            }
+
+            int RttHistogram::bucketOf(uint64_t value) {
+                if(value < (uint64_t)LINEAR_LIMIT)
+                    return (int)value;
+                int msb = highestBit(value);
+                int shift = msb - SUB_BUCKET_BITS;
+                int sub = (int)((value >> shift) & ((1 << SUB_BUCKET_BITS) - 1));
+                return LINEAR_LIMIT + (msb - SUB_BUCKET_BITS - 1) * (1 << SUB_BUCKET_BITS) + sub;
+            }
+
+            uint64_t RttHistogram::bucketUpperBound(int index) {
+                if(index < LINEAR_LIMIT)
+                    return (uint64_t)index;
+                int msb = SUB_BUCKET_BITS + 1 + (index - LINEAR_LIMIT) / (1 << SUB_BUCKET_BITS);
+                int sub = (index - LINEAR_LIMIT) % (1 << SUB_BUCKET_BITS);
+                int shift = msb - SUB_BUCKET_BITS;
+                uint64_t lower = ((uint64_t)((1 << SUB_BUCKET_BITS) + sub)) << shift;
+                return lower + (((uint64_t)1) << shift) - 1;
+            }
+
+            void RttHistogram::add(uint64_t value_us) {
+                if(count_ == window_.size()) {
+                    uint64_t evicted = window_[next_];
+                    buckets_[bucketOf(evicted)]--;
+                    sum_ -= evicted;
+                }else{
+                    count_++;
+                }
+                window_[next_] = value_us;
+                next_ = (next_ + 1) % window_.size();
+                buckets_[bucketOf(value_us)]++;
+                sum_ += value_us;
+                last_ = value_us;
+            }
+
+            void RttHistogram::clear() {
+                next_ = 0;
+                count_ = 0;
+                sum_ = 0;
+                last_ = 0;
+                for(auto it = buckets_.begin(); it != buckets_.end(); it++) {
+                    *it = 0;
+                }
+            }
+
+            uint64_t RttHistogram::min() const {
+                if(!count_)
+                    return 0;
+                uint64_t value = UINT64_MAX;
+                for(size_t i = 0; i < count_; i++) {
+                    if(window_[i] < value)
+                        value = window_[i];
+                }
+                return value;
+            }
+
+            uint64_t RttHistogram::max() const {
+                uint64_t value = 0;
+                for(size_t i = 0; i < count_; i++) {
+                    if(window_[i] > value)
+                        value = window_[i];
+                }
+                return value;
+            }
+
+            double RttHistogram::mean() const {
+                return count_ ? ((double)sum_ / (double)count_) : 0.0;
+            }
+
+            uint64_t RttHistogram::percentile(double p) const {
+                if(!count_)
+                    return 0;
+                if(p < 0.0)
+                    p = 0.0;
+                if(p > 1.0)
+                    p = 1.0;
+                // Nearest rank: the smallest sample with at least p of the samples at or below it
+                size_t rank = (size_t)ceil(p * (double)count_);
+                if(rank < 1)
+                    rank = 1;
+                if(rank > count_)
+                    rank = count_;
+                size_t seen = 0;
+                for(int i = 0; i < BUCKET_COUNT; i++) {
+                    seen += buckets_[i];
+                    if(seen >= rank)
+                        return bucketUpperBound(i);
+                }
+                return max();
+            }
+
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file	rtt_histogram.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __SRC_UTILS_RTT_HISTOGRAM_H__
+#define __SRC_UTILS_RTT_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace jcu {
+    namespace node_ipc {
+        namespace utils {
+
+            /**
+             * Histogram over the last N samples (microseconds).
+             * Buckets are log-linear: 8 sub-buckets per power of two, so percentiles
+             * are accurate to about 12%.
+             */
+            class RttHistogram {
+            public:
+                RttHistogram(size_t window = 1024);
+
+                void add(uint64_t value_us);
+                void clear();
+
+                size_t count() const {
+                    return count_;
+                }
+                uint64_t last() const {
+                    return last_;
+                }
+                uint64_t min() const;
+                uint64_t max() const;
+                double mean() const;
+
+                /**
+                 * @param p 0.0 ~ 1.0
+                 * @return upper bound of the bucket holding the nearest-rank p-th sample
+                 */
+                uint64_t percentile(double p) const;
+
+            private:
+                static const int SUB_BUCKET_BITS = 3;
+                static const int LINEAR_LIMIT = 1 << (SUB_BUCKET_BITS + 1);
+                static const int BUCKET_COUNT = LINEAR_LIMIT + (64 - SUB_BUCKET_BITS - 1) * (1 << SUB_BUCKET_BITS);
+
+                static int bucketOf(uint64_t value);
+                static uint64_t bucketUpperBound(int index);
+
+                std::vector<uint64_t> window_;
+                size_t next_;
+                size_t count_;
+                uint64_t sum_;
+                uint64_t last_;
+                std::vector<uint32_t> buckets_;
+            };
+
+        }
+    }
+}
+
+#endif //__SRC_UTILS_RTT_HISTOGRAM_H__
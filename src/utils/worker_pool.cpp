@@ -0,0 +1,212 @@
+/**
+ * @file	worker_pool.cpp
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "worker_pool.h"
+
+namespace jcu {
+    namespace node_ipc {
+        namespace utils {
+
+            // Number of tasks a worker runs from one strand before giving other strands a turn
+            static const int STRAND_BATCH_SIZE = 16;
+
+            static thread_local bool tls_is_worker_thread = false;
+
+            WorkerPool::WorkerPool(size_t threads, size_t queue_limit, Task_t on_space)
+                : queued_strands_(0), stopping_(false), queue_limit_(queue_limit), pending_(0),
+                  on_space_(on_space), space_wanted_(false) {
+                if(threads == 0) {
+                    threads = std::thread::hardware_concurrency();
+                    if(threads == 0)
+                        threads = 1;
+                }
+                for(size_t i = 0; i < threads; i++) {
+                    workers_.emplace_back(new Worker());
+                }
+                for(size_t i = 0; i < threads; i++) {
+                    workers_[i]->thread = std::thread(&WorkerPool::run, this, i);
+                }
+            }
+
+            WorkerPool::~WorkerPool() {
+                {
+                    std::unique_lock<std::mutex> lock(idle_mutex_);
+                    stopping_ = true;
+                }
+                idle_cv_.notify_all();
+                space_cv_.notify_all();
+                for(auto it = workers_.begin(); it != workers_.end(); it++) {
+                    if((*it)->thread.joinable())
+                        (*it)->thread.join();
+                }
+            }
+
+            bool WorkerPool::isWorkerThread() {
+                return tls_is_worker_thread;
+            }
+
+            bool WorkerPool::saturated() {
+                if(queue_limit_ == 0 || pending_.load() < queue_limit_)
+                    return false;
+                space_wanted_ = true;
+                // Workers may have drained past the low mark before they could see space_wanted_
+                if(pending_.load() <= queue_limit_ / 2 && space_wanted_.exchange(false))
+                    return false;
+                return true;
+            }
+
+            void WorkerPool::waitForSpace() {
+                if(queue_limit_ == 0)
+                    return;
+                std::unique_lock<std::mutex> lock(space_mutex_);
+                space_cv_.wait(lock, [this]() -> bool {
+                    return pending_.load() < queue_limit_ || stopping_;
+                });
+            }
+
+            void WorkerPool::waitIdle() {
+                std::unique_lock<std::mutex> lock(space_mutex_);
+                space_cv_.wait(lock, [this]() -> bool {
+                    return pending_.load() == 0 || stopping_;
+                });
+            }
+
+            void WorkerPool::submit(const std::string& key, Task_t task) {
+                pending_++;
+
+                std::shared_ptr<Strand> strand;
+                bool need_schedule = false;
+                {
+                    std::unique_lock<std::mutex> map_lock(strands_mutex_);
+                    std::shared_ptr<Strand>& slot = strands_[key];
+                    if(!slot) {
+                        slot.reset(new Strand(key));
+                    }
+                    strand = slot;
+
+                    std::unique_lock<std::mutex> strand_lock(strand->mutex);
+                    strand->tasks.emplace_back(std::move(task));
+                    if(!strand->scheduled) {
+                        strand->scheduled = true;
+                        need_schedule = true;
+                    }
+                }
+
+                if(need_schedule) {
+                    size_t home = std::hash<std::string>()(key) % workers_.size();
+                    schedule(home, std::move(strand));
+                }
+            }
+
+            void WorkerPool::schedule(size_t worker_index, std::shared_ptr<Strand> strand) {
+                Worker& worker = *workers_[worker_index];
+                {
+                    std::unique_lock<std::mutex> lock(worker.mutex);
+                    worker.run_queue.emplace_back(std::move(strand));
+                }
+                {
+                    std::unique_lock<std::mutex> lock(idle_mutex_);
+                    queued_strands_++;
+                }
+                idle_cv_.notify_one();
+            }
+
+            std::shared_ptr<WorkerPool::Strand> WorkerPool::take(size_t worker_index) {
+                std::shared_ptr<Strand> strand;
+                size_t count = workers_.size();
+
+                {
+                    Worker& self = *workers_[worker_index];
+                    std::unique_lock<std::mutex> lock(self.mutex);
+                    if(!self.run_queue.empty()) {
+                        strand = std::move(self.run_queue.front());
+                        self.run_queue.pop_front();
+                    }
+                }
+
+                for(size_t n = 1; !strand && n < count; n++) {
+                    Worker& victim = *workers_[(worker_index + n) % count];
+                    std::unique_lock<std::mutex> lock(victim.mutex);
+                    if(!victim.run_queue.empty()) {
+                        strand = std::move(victim.run_queue.back());
+                        victim.run_queue.pop_back();
+                    }
+                }
+
+                if(strand) {
+                    std::unique_lock<std::mutex> lock(idle_mutex_);
+                    queued_strands_--;
+                }
+                return strand;
+            }
+
+            void WorkerPool::run(size_t worker_index) {
+                tls_is_worker_thread = true;
+                for(;;) {
+                    std::shared_ptr<Strand> strand = take(worker_index);
+                    if(strand) {
+                        runStrand(worker_index, strand);
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(idle_mutex_);
+                    idle_cv_.wait(lock, [this]() -> bool {
+                        return queued_strands_ > 0 || stopping_;
+                    });
+                    if(stopping_ && queued_strands_ == 0)
+                        break;
+                }
+            }
+
+            void WorkerPool::runStrand(size_t worker_index, const std::shared_ptr<Strand>& strand) {
+                for(int i = 0; i < STRAND_BATCH_SIZE; i++) {
+                    Task_t task;
+                    {
+                        std::unique_lock<std::mutex> lock(strand->mutex);
+                        if(strand->tasks.empty())
+                            break;
+                        task = std::move(strand->tasks.front());
+                        strand->tasks.pop_front();
+                    }
+
+                    task();
+
+                    size_t prev_pending = pending_.fetch_sub(1);
+                    if(prev_pending == 1 || (queue_limit_ > 0 && prev_pending >= queue_limit_)) {
+                        // Wakes waitForSpace() and, on the last task, waitIdle()
+                        std::unique_lock<std::mutex> lock(space_mutex_);
+                        space_cv_.notify_all();
+                    }
+                    if(queue_limit_ > 0) {
+                        if(prev_pending - 1 <= queue_limit_ / 2 && space_wanted_.load() && space_wanted_.exchange(false) && on_space_) {
+                            on_space_();
+                        }
+                    }
+                }
+
+                {
+                    std::unique_lock<std::mutex> map_lock(strands_mutex_);
+                    std::unique_lock<std::mutex> strand_lock(strand->mutex);
+                    if(strand->tasks.empty()) {
+                        strand->scheduled = false;
+                        auto it = strands_.find(strand->key);
+                        if(it != strands_.end() && it->second == strand) {
+                            strands_.erase(it);
+                        }
+                        return;
+                    }
+                }
+
+                // Strand still has work: requeue it behind the other strands of this worker
+                schedule(worker_index, strand);
+            }
+
+        }
+    }
+}
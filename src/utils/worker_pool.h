@@ -0,0 +1,123 @@
+/**
+ * @file	worker_pool.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2019/12/13
+ * @copyright Copyright (C) 2019 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef __SRC_UTILS_WORKER_POOL_H__
+#define __SRC_UTILS_WORKER_POOL_H__
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace jcu {
+    namespace node_ipc {
+        namespace utils {
+
+            /**
+             * Work-stealing thread pool with per-key ordering.
+             *
+             * Tasks submitted with the same key run one at a time in submission order.
+             * Each key is a strand that is queued on its home worker; idle workers steal
+             * strands from the tail of other workers' queues.
+             */
+            class WorkerPool {
+            public:
+                typedef std::function<void()> Task_t;
+
+                /**
+                 * @param threads     number of worker threads (0 = hardware concurrency)
+                 * @param queue_limit pending tasks at which the pool reports saturated() (0 = unbounded)
+                 * @param on_space    called on a worker thread once a saturated pool drains to half the limit
+                 */
+                WorkerPool(size_t threads, size_t queue_limit, Task_t on_space = nullptr);
+                ~WorkerPool();
+
+                /**
+                 * Queue a task on the strand of key. Never blocks: the caller is expected to
+                 * stop producing while saturated() is true.
+                 */
+                void submit(const std::string& key, Task_t task);
+
+                /**
+                 * @return True if queue_limit tasks are pending. on_space is then called once
+                 *         the backlog falls to half the limit.
+                 */
+                bool saturated();
+
+                /**
+                 * Block the calling thread until the pool is below queue_limit.
+                 * For callers without an event loop to return to.
+                 */
+                void waitForSpace();
+
+                /**
+                 * Block the calling thread until every submitted task has run.
+                 * Must not be called from a worker thread.
+                 */
+                void waitIdle();
+
+                size_t pending() const {
+                    return pending_.load();
+                }
+
+                /**
+                 * @return True if the calling thread is a worker of any WorkerPool
+                 */
+                static bool isWorkerThread();
+
+            private:
+                struct Strand {
+                    std::string key;
+                    std::mutex mutex;
+                    std::deque<Task_t> tasks;
+                    bool scheduled;
+
+                    Strand(const std::string& k) : key(k), scheduled(false) {}
+                };
+
+                struct Worker {
+                    std::mutex mutex;
+                    std::deque<std::shared_ptr<Strand>> run_queue;
+                    std::thread thread;
+                };
+
+                std::vector<std::unique_ptr<Worker>> workers_;
+
+                std::mutex strands_mutex_;
+                std::unordered_map<std::string, std::shared_ptr<Strand>> strands_;
+
+                std::mutex idle_mutex_;
+                std::condition_variable idle_cv_;
+                size_t queued_strands_;
+                std::atomic<bool> stopping_;
+
+                size_t queue_limit_;
+                std::atomic<size_t> pending_;
+                Task_t on_space_;
+                std::atomic<bool> space_wanted_;
+                std::mutex space_mutex_;
+                std::condition_variable space_cv_;
+
+                void schedule(size_t worker_index, std::shared_ptr<Strand> strand);
+                std::shared_ptr<Strand> take(size_t worker_index);
+                void run(size_t worker_index);
+                void runStrand(size_t worker_index, const std::shared_ptr<Strand>& strand);
+            };
+
+        }
+    }
+}
+
+#endif //__SRC_UTILS_WORKER_POOL_H__
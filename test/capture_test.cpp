@@ -0,0 +1,221 @@
+/**
+ * CaptureFile record reading and replay
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <jcu/node_ipc/client.h>
+#include <jcu/node_ipc/ipc_config.h>
+#include <jcu/node_ipc/capture.h>
+
+#include "capture_writer.h"
+
+using namespace jcu::node_ipc;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+static const char *CAPTURE_PATH = "capture_test.jnic";
+static const char *DAMAGED_PATH = "capture_test_damaged.jnic";
+
+static std::string readFile(const char *path) {
+    std::string content;
+    FILE *fp = fopen(path, "rb");
+    if(!fp)
+        return content;
+    char buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        content.append(buf, n);
+    }
+    fclose(fp);
+    return content;
+}
+
+static void writeFile(const char *path, const std::string& content) {
+    FILE *fp = fopen(path, "wb");
+    if(!fp)
+        return;
+    fwrite(content.data(), 1, content.length(), fp);
+    fclose(fp);
+}
+
+static void writeCapture(const std::vector<std::string>& records) {
+    std::unique_ptr<CaptureWriter> writer = CaptureWriter::create(CAPTURE_PATH);
+    CHECK(writer != nullptr);
+    if(!writer)
+        return;
+    for(size_t i = 0; i < records.size(); i++) {
+        writer->write((i % 2) ? CAPTURE_OUTBOUND : CAPTURE_INBOUND, records[i].data(), records[i].length());
+    }
+}
+
+static std::vector<std::string> readRecords(const CaptureFile& file) {
+    std::vector<std::string> records;
+    size_t offset = 0;
+    CaptureRecord record;
+    while(file.next(offset, record)) {
+        records.push_back(std::string(record.data, record.length));
+    }
+    return records;
+}
+
+static void testRecords() {
+    std::vector<std::string> records = { "first", "", "third record" };
+    writeCapture(records);
+
+    std::unique_ptr<CaptureFile> file = CaptureFile::open(CAPTURE_PATH);
+    CHECK(file != nullptr);
+    if(!file)
+        return;
+    CHECK(file->startTime() > 0);
+
+    size_t offset = 0;
+    CaptureRecord record;
+    uint64_t last_timestamp = 0;
+    for(size_t i = 0; i < records.size(); i++) {
+        CHECK(file->next(offset, record));
+        CHECK(record.direction == ((i % 2) ? CAPTURE_OUTBOUND : CAPTURE_INBOUND));
+        CHECK(std::string(record.data, record.length) == records[i]);
+        CHECK(record.timestamp_ns >= last_timestamp);
+        last_timestamp = record.timestamp_ns;
+    }
+    CHECK(!file->next(offset, record));
+    // The end stays the end
+    CHECK(!file->next(offset, record));
+}
+
+static void testTruncated() {
+    writeCapture({ "first", "second" });
+    std::string content = readFile(CAPTURE_PATH);
+    const size_t header_size = 16;
+    const size_t record_header_size = 13;
+    CHECK(content.length() == header_size + 2 * record_header_size + 5 + 6);
+
+    // Cut inside the data of the last record
+    writeFile(DAMAGED_PATH, content.substr(0, content.length() - 1));
+    std::unique_ptr<CaptureFile> file = CaptureFile::open(DAMAGED_PATH);
+    CHECK(file != nullptr);
+    if(file) {
+        std::vector<std::string> records = readRecords(*file);
+        CHECK(records.size() == 1 && records[0] == "first");
+    }
+    file.reset();
+
+    // Cut inside the header of the last record
+    writeFile(DAMAGED_PATH, content.substr(0, header_size + record_header_size + 5 + 4));
+    file = CaptureFile::open(DAMAGED_PATH);
+    CHECK(file != nullptr);
+    if(file) {
+        std::vector<std::string> records = readRecords(*file);
+        CHECK(records.size() == 1 && records[0] == "first");
+    }
+    file.reset();
+
+    // Header only
+    writeFile(DAMAGED_PATH, content.substr(0, header_size));
+    file = CaptureFile::open(DAMAGED_PATH);
+    CHECK(file != nullptr);
+    if(file) {
+        CHECK(readRecords(*file).empty());
+    }
+    file.reset();
+
+    // A length far past the end of the file
+    std::string oversized = content.substr(0, header_size + record_header_size);
+    oversized[header_size + 9 + 3] = (char)0x7f;
+    writeFile(DAMAGED_PATH, oversized);
+    file = CaptureFile::open(DAMAGED_PATH);
+    CHECK(file != nullptr);
+    if(file) {
+        CHECK(readRecords(*file).empty());
+    }
+}
+
+static void testBadHeader() {
+    writeCapture({ "first" });
+    std::string content = readFile(CAPTURE_PATH);
+
+    std::string bad_magic = content;
+    bad_magic[0] = 'X';
+    writeFile(DAMAGED_PATH, bad_magic);
+    CHECK(CaptureFile::open(DAMAGED_PATH) == nullptr);
+
+    std::string bad_version = content;
+    bad_version[4] = 99;
+    writeFile(DAMAGED_PATH, bad_version);
+    CHECK(CaptureFile::open(DAMAGED_PATH) == nullptr);
+
+    writeFile(DAMAGED_PATH, content.substr(0, 10));
+    CHECK(CaptureFile::open(DAMAGED_PATH) == nullptr);
+
+    writeFile(DAMAGED_PATH, "");
+    CHECK(CaptureFile::open(DAMAGED_PATH) == nullptr);
+
+    remove(DAMAGED_PATH);
+    CHECK(CaptureFile::open(DAMAGED_PATH) == nullptr);
+}
+
+static void testReplay() {
+    // Inbound records split frames anywhere; outbound records are skipped
+    std::vector<std::string> records = {
+        "{\"type\":\"m\",\"data\":1}\x0c{\"type\":\"m\",",
+        "{\"type\":\"ignored\",\"data\":0}\x0c",
+        "\"data\":2}\x0c{\"type\":\"m\",\"data\":3}\x0c"
+    };
+    writeCapture(records);
+    std::unique_ptr<CaptureFile> file = CaptureFile::open(CAPTURE_PATH);
+    CHECK(file != nullptr);
+    if(!file)
+        return;
+
+    std::shared_ptr<Client> client = Client::create();
+    client->config().worker_threads = 2;
+    std::atomic<int> sum(0);
+    std::atomic<int> ignored(0);
+    MessageDispatchOptions options;
+    options.offload = true;
+    client->onMessage("m", [&](Json::Value& data) -> void {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sum += data.asInt();
+    }, options);
+    client->onMessage("ignored", [&](Json::Value& data) -> void {
+        ignored++;
+    });
+
+    ReplayStats stats = replayCapture(*file, *client);
+    CHECK(stats.records == 2);
+    CHECK(stats.bytes == records[0].length() + records[2].length());
+    // Offloaded handlers have finished before replayCapture returns
+    CHECK(sum == 6);
+    CHECK(ignored == 0);
+    CHECK(stats.seconds >= 0.02);
+}
+
+int main() {
+    testRecords();
+    testTruncated();
+    testBadHeader();
+    testReplay();
+    remove(CAPTURE_PATH);
+    remove(DAMAGED_PATH);
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * Latest-value conflation of outbound messages.
+ *
+ * Frames are held back while the client is disconnected or the link is full.
+ * A shared memory ring created here stands in for the peer, so the client
+ * connects and drains without a socket.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <uvw/timer.hpp>
+#include <json/json.h>
+
+#include <jcu/node_ipc/client.h>
+#include <jcu/node_ipc/ipc_config.h>
+#include <jcu/node_ipc/shm_ring.h>
+
+using namespace jcu::node_ipc;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+static std::string shmName(const char *test) {
+    return "/jcu-node-ipc.conflation-test." + std::to_string(getpid()) + "." + test;
+}
+
+/**
+ * Peer end of the ring: collects the frames the client wrote
+ */
+struct Peer {
+    std::unique_ptr<ShmRing> ring;
+    std::string partial;
+    std::vector<Json::Value> messages;
+
+    void read() {
+        const char *data;
+        size_t length;
+        while((length = ring->peek(&data)) > 0) {
+            partial.append(data, length);
+            ring->consume(length);
+        }
+        size_t delimiter;
+        while((delimiter = partial.find((char)0x0c)) != std::string::npos) {
+            Json::Value message;
+            Json::CharReaderBuilder reader_builder;
+            std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+            std::string err;
+            CHECK(reader->parse(partial.data(), partial.data() + delimiter, &message, &err));
+            messages.push_back(message);
+            partial.erase(0, delimiter + 1);
+        }
+    }
+};
+
+static std::shared_ptr<Client> createClient(const std::shared_ptr<uvw::Loop>& loop, const std::string& shm_name) {
+    std::shared_ptr<Client> client = Client::create();
+    client->config().loop = loop;
+    client->config().shm.enabled = true;
+    client->config().shm.name = shm_name;
+    return client;
+}
+
+static std::unique_ptr<char[]> makeFrame(const std::string& type, int value, size_t& length) {
+    std::string text = "{\"type\":\"" + type + "\",\"data\":" + std::to_string(value) + "}";
+    text.push_back(0x0c);
+    length = text.length();
+    std::unique_ptr<char[]> frame(new char[length]);
+    memcpy(frame.get(), text.data(), length);
+    return frame;
+}
+
+static void testHeldWhileDisconnected() {
+    std::shared_ptr<uvw::Loop> loop = uvw::Loop::create();
+    std::string shm_name = shmName("held");
+    Peer peer;
+    peer.ring = ShmRing::create(shm_name, 64 * 1024);
+    CHECK(peer.ring != nullptr);
+    if(!peer.ring)
+        return;
+
+    std::shared_ptr<Client> client = createClient(loop, shm_name);
+    client->setConflation("price", [](const Json::Value& data, const std::string& type) -> std::string {
+        return data["id"].asString();
+    });
+    client->setConflation("status");
+    Channel<int32_t> level = client->channel<int32_t>("level");
+    level.setConflation([](const int32_t& value) -> std::string {
+        return std::to_string(value % 2);
+    });
+
+    // Handlers of fed input emit while there is no connection
+    client->onMessage("tick", [&](Json::Value& data) -> void {
+        Json::Value price;
+        price["id"] = data["id"];
+        price["v"] = data["v"];
+        client->emit("price", price);
+    });
+    const char *ticks =
+        "{\"type\":\"tick\",\"data\":{\"id\":1,\"v\":1}}\x0c"
+        "{\"type\":\"tick\",\"data\":{\"id\":2,\"v\":1}}\x0c"
+        "{\"type\":\"tick\",\"data\":{\"id\":1,\"v\":2}}\x0c";
+    client->feed(ticks, strlen(ticks));
+
+    size_t length;
+    std::unique_ptr<char[]> frame = makeFrame("status", 1, length);
+    client->emitFrame("status", std::move(frame), length);
+    frame = makeFrame("status", 2, length);
+    client->emitFrame("status", std::move(frame), length);
+
+    for(int32_t i = 1; i <= 4; i++) {
+        level.emit(i);
+    }
+
+    // Replaced in place: the first key of each type keeps its position
+    client->connectToNet("conflation-test", "", 0);
+    CHECK(client->isConnected());
+    peer.read();
+    CHECK(peer.messages.size() == 5);
+    if(peer.messages.size() == 5) {
+        CHECK(peer.messages[0]["type"] == "price" && peer.messages[0]["data"]["id"] == 1 && peer.messages[0]["data"]["v"] == 2);
+        CHECK(peer.messages[1]["type"] == "price" && peer.messages[1]["data"]["id"] == 2 && peer.messages[1]["data"]["v"] == 1);
+        CHECK(peer.messages[2]["type"] == "status" && peer.messages[2]["data"] == 2);
+        CHECK(peer.messages[3]["type"] == "level" && peer.messages[3]["data"] == 3);
+        CHECK(peer.messages[4]["type"] == "level" && peer.messages[4]["data"] == 4);
+    }
+
+    // Connected with room in the ring: sent right away
+    level.emit(5);
+    level.emit(7);
+    peer.read();
+    CHECK(peer.messages.size() == 7);
+
+    client->close();
+    client.reset();
+    peer.ring->close();
+    loop->run();
+}
+
+static void testFlushOnDrain() {
+    std::shared_ptr<uvw::Loop> loop = uvw::Loop::create();
+    std::string shm_name = shmName("drain");
+    Peer peer;
+    peer.ring = ShmRing::create(shm_name, 4096);
+    CHECK(peer.ring != nullptr);
+    if(!peer.ring)
+        return;
+
+    std::shared_ptr<Client> client = createClient(loop, shm_name);
+    client->setConflation("value", [](const Json::Value& data, const std::string& type) -> std::string {
+        return data["key"].asString();
+    });
+    client->connectToNet("conflation-test", "", 0);
+    CHECK(client->isConnected());
+
+    // Far more than the ring holds while the peer is not reading
+    const int key_count = 4;
+    const int count = 2000;
+    for(int i = 0; i < count; i++) {
+        Json::Value data;
+        data["key"] = i % key_count;
+        data["seq"] = i;
+        client->emit("value", data);
+    }
+
+    std::map<int, int> last_seq;
+    int received = 0;
+    int ticks = 0;
+    std::shared_ptr<uvw::TimerHandle> timer = loop->resource<uvw::TimerHandle>();
+    timer->on<uvw::TimerEvent>([&](uvw::TimerEvent &evt, uvw::TimerHandle &handle) -> void {
+        peer.read();
+        for(auto it = peer.messages.begin(); it != peer.messages.end(); it++) {
+            int key = (*it)["data"]["key"].asInt();
+            int seq = (*it)["data"]["seq"].asInt();
+            CHECK(last_seq.find(key) == last_seq.end() || last_seq[key] < seq);
+            last_seq[key] = seq;
+            received++;
+        }
+        bool done = (int)last_seq.size() == key_count;
+        for(auto it = last_seq.begin(); it != last_seq.end(); it++) {
+            done = done && it->second >= count - key_count;
+        }
+        if(done || ++ticks > 5000) {
+            // The connected link keeps the loop alive
+            handle.close();
+            handle.loop().stop();
+            return;
+        }
+        peer.messages.clear();
+    });
+    timer->start(uvw::TimerHandle::Time{1}, uvw::TimerHandle::Time{1});
+    loop->run();
+
+    // The newest value of every key arrived once the link drained, older ones were replaced
+    CHECK(received < count);
+    CHECK((int)last_seq.size() == key_count);
+    for(int key = 0; key < key_count; key++) {
+        CHECK(last_seq[key] == count - key_count + key);
+    }
+
+    client->close();
+    client.reset();
+    peer.ring->close();
+    loop->run();
+}
+
+int main() {
+    testHeldWhileDisconnected();
+    testFlushOnDrain();
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
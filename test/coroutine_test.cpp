@@ -0,0 +1,213 @@
+/**
+ * co_await adapters of coroutine.h against the real client, driven through feed()
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <memory>
+
+#include <jcu/node_ipc/client.h>
+#include <jcu/node_ipc/ipc_config.h>
+#include <jcu/node_ipc/coroutine.h>
+
+#ifndef JCU_NODE_IPC_HAS_COROUTINE
+
+int main() {
+    printf("compiler without C++20 coroutines, skipped\n");
+    // ctest SKIP_RETURN_CODE
+    return 77;
+}
+
+#else
+
+using namespace jcu::node_ipc;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+/**
+ * Eagerly started coroutine that stays suspended at its end until the Task is destroyed
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& o) noexcept : handle(o.handle) {
+        o.handle = nullptr;
+    }
+    Task(const Task&) = delete;
+    ~Task() {
+        destroy();
+    }
+
+    bool done() const {
+        return handle && handle.done();
+    }
+    void destroy() {
+        if(handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+};
+
+static void feedText(Client& client, const std::string& text) {
+    std::string frame = text + (char)0x0c;
+    client.feed(frame.data(), frame.length());
+}
+
+static Task connectTask(Client& client, bool& result) {
+    result = co_await connect(client, "coroutine-test", "127.0.0.1", 1);
+}
+
+static void testConnectClosed() {
+    std::shared_ptr<uvw::Loop> loop = uvw::Loop::create();
+    std::shared_ptr<Client> client = Client::create();
+    client->config().loop = loop;
+
+    bool result = true;
+    Task task = connectTask(*client, result);
+    CHECK(!task.done());
+
+    client->close();
+    CHECK(task.done());
+    CHECK(!result);
+
+    client.reset();
+    // Let the closed handles finish
+    loop->run();
+}
+
+static Task nextMessageTask(Client& client, const std::string& type, int& count, Json::Value& last) {
+    for(;;) {
+        std::optional<Json::Value> data = co_await nextMessage(client, type);
+        if(!data)
+            break;
+        last = *data;
+        count++;
+    }
+}
+
+static Task channelTask(Channel<int32_t> channel, int32_t& sum) {
+    for(;;) {
+        std::optional<int32_t> value = co_await nextMessage(channel);
+        if(!value)
+            break;
+        sum += *value;
+    }
+}
+
+static void testNextMessage() {
+    std::shared_ptr<Client> client = Client::create();
+    const std::string type("tick");
+
+    int count = 0;
+    Json::Value last;
+    Task task = nextMessageTask(*client, type, count, last);
+    int32_t sum = 0;
+    Task channel_task = channelTask(client->channel<int32_t>("num"), sum);
+
+    feedText(*client, "{\"type\":\"tick\",\"data\":{\"n\":1}}");
+    // Two frames in one read
+    feedText(*client, "{\"type\":\"other\",\"data\":0}\x0c{\"type\":\"tick\",\"data\":{\"n\":2}}");
+    CHECK(count == 2);
+    CHECK(last["n"].asInt() == 2);
+
+    feedText(*client, "{\"type\":\"num\",\"data\":3}");
+    feedText(*client, "{\"type\":\"num\",\"data\":4}");
+    CHECK(sum == 7);
+    CHECK(!task.done() && !channel_task.done());
+
+    // close() resumes every waiter with an empty result
+    client->close();
+    CHECK(task.done() && channel_task.done());
+    CHECK(count == 2 && sum == 7);
+}
+
+static Task requestTask(Client& client, const std::string& type, const Json::Value& data, const std::string& reply_type,
+                        std::optional<Json::Value>& reply) {
+    reply = co_await request(client, type, data, reply_type);
+}
+
+static void testRequest() {
+    std::shared_ptr<Client> client = Client::create();
+    const std::string type("ping");
+    const std::string reply_type("pong");
+    Json::Value data;
+    data["seq"] = 5;
+
+    std::optional<Json::Value> reply;
+    Task task = requestTask(*client, type, data, reply_type, reply);
+    CHECK(!task.done());
+
+    feedText(*client, "{\"type\":\"ping\",\"data\":{\"seq\":5}}");
+    CHECK(!task.done());
+    feedText(*client, "{\"type\":\"pong\",\"data\":{\"seq\":5,\"ok\":true}}");
+    CHECK(task.done());
+    CHECK(reply && (*reply)["seq"].asInt() == 5 && (*reply)["ok"].asBool());
+
+    // Invalid data resumes with an empty result
+    reply = Json::Value();
+    Task bad_task = requestTask(*client, type, data, reply_type, reply);
+    feedText(*client, "{\"type\":\"pong\",\"data\":[1 2]}");
+    CHECK(bad_task.done());
+    CHECK(!reply);
+}
+
+static void testDestroyAfterClient() {
+    std::shared_ptr<Client> client = Client::create();
+    const std::string type("never");
+
+    int count = 0;
+    Json::Value last;
+    Task task = nextMessageTask(*client, type, count, last);
+    int32_t sum = 0;
+    Task channel_task = channelTask(client->channel<int32_t>("never-num"), sum);
+    CHECK(!task.done() && !channel_task.done());
+
+    // The awaiters in the suspended frames must not touch the destroyed client
+    client.reset();
+    CHECK(!task.done() && !channel_task.done());
+    task.destroy();
+    channel_task.destroy();
+    CHECK(count == 0 && sum == 0);
+}
+
+int main() {
+    testConnectClosed();
+    testNextMessage();
+    testRequest();
+    testDestroyAfterClient();
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
+
+#endif
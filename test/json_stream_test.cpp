@@ -0,0 +1,258 @@
+/**
+ * JsonWriter / JsonReader and message envelope scan
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <locale.h>
+
+#include <string>
+#include <vector>
+
+#include <jcu/node_ipc/json_stream.h>
+#include <jcu/node_ipc/message_traits.h>
+
+#include "message_frame.h"
+
+using namespace jcu::node_ipc;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+static std::string written(JsonWriter& writer) {
+    return std::string(writer.data(), writer.size());
+}
+
+template<typename T>
+static bool readText(const std::string& text, T& v) {
+    JsonReader reader(text.data(), text.data() + text.length());
+    return reader.read(v);
+}
+
+struct NullSink : public DecodeErrorSink {
+    int errors;
+    NullSink() : errors(0) {}
+    void onDecodeError(const std::string& what) override {
+        errors++;
+    }
+};
+
+static bool scanEnvelope(const std::string& text, std::string& type, std::string& data) {
+    NullSink sink;
+    MessageFrame frame(text.data(), text.data() + text.length(), &sink);
+    std::string err_text;
+    if(!frame.decodeEnvelope(err_text))
+        return false;
+    type = frame.type();
+    data.assign(frame.dataBegin(), frame.dataEnd());
+    return true;
+}
+
+static void testWriter() {
+    JsonWriter writer;
+    writer.beginObject();
+    writer.member("i", (int)-1);
+    writer.member("ll", (long long)1);
+    writer.member("ull", (unsigned long long)ULLONG_MAX);
+    writer.member("l", (long)LONG_MIN);
+    writer.member("i64", (int64_t)INT64_MIN);
+    writer.member("u32", (uint32_t)7);
+    writer.member("s", std::string("a\"b\\\n\x01"));
+    writer.member("b", true);
+    writer.key("arr");
+    writer.beginArray();
+    writer.value(1);
+    writer.valueNull();
+    writer.beginObject();
+    writer.endObject();
+    writer.endArray();
+    writer.endObject();
+    CHECK(written(writer) == "{\"i\":-1,\"ll\":1,\"ull\":18446744073709551615,\"l\":-9223372036854775808,"
+                             "\"i64\":-9223372036854775808,\"u32\":7,\"s\":\"a\\\"b\\\\\\n\\u0001\",\"b\":true,"
+                             "\"arr\":[1,null,{}]}");
+}
+
+static void testIntegers() {
+    long long ll = 0;
+    CHECK(readText("9223372036854775807", ll) && ll == LLONG_MAX);
+    CHECK(readText("-9223372036854775808", ll) && ll == LLONG_MIN);
+    CHECK(!readText("9223372036854775808", ll));
+    CHECK(!readText("-9223372036854775809", ll));
+    CHECK(!readText("99999999999999999999", ll));
+    CHECK(readText("1e3", ll) && ll == 1000);
+    CHECK(readText("-2.0", ll) && ll == -2);
+    CHECK(!readText("1.5", ll));
+    CHECK(!readText("1e300", ll));
+    CHECK(!readText("9.3e18", ll));
+
+    unsigned long long ull = 0;
+    CHECK(readText("18446744073709551615", ull) && ull == ULLONG_MAX);
+    CHECK(!readText("18446744073709551616", ull));
+    CHECK(!readText("99999999999999999999", ull));
+    CHECK(!readText("-1", ull));
+    CHECK(readText("-0", ull) && ull == 0);
+    CHECK(!readText("1.8446744073709552e19", ull));
+
+    int i = 0;
+    CHECK(readText("2147483647", i) && i == INT_MAX);
+    CHECK(!readText("2147483648", i));
+    CHECK(readText("-2147483648", i) && i == INT_MIN);
+
+    unsigned int u = 0;
+    CHECK(readText("4294967295", u) && u == UINT_MAX);
+    CHECK(!readText("4294967296", u));
+
+    int64_t i64 = 0;
+    CHECK(readText("-42", i64) && i64 == -42);
+    uint32_t u32 = 0;
+    CHECK(readText("42", u32) && u32 == 42);
+}
+
+static void testNumberGrammar() {
+    double d = 0;
+    CHECK(readText("0", d) && d == 0);
+    CHECK(readText("-0.5e-2", d) && d == -0.005);
+    CHECK(readText("1E+2", d) && d == 100);
+    CHECK(!readText("1-2", d));
+    CHECK(!readText("01", d));
+    CHECK(!readText("-", d));
+    CHECK(!readText("+1", d));
+    CHECK(!readText(".5", d));
+    CHECK(!readText("1.", d));
+    CHECK(!readText("1e", d));
+    CHECK(!readText("1e+", d));
+    CHECK(!readText("1.2.3", d));
+    CHECK(!readText("0x10", d));
+
+    long long ll = 0;
+    CHECK(!readText("1-2", ll));
+}
+
+static void testStrings() {
+    std::string s;
+    CHECK(readText("\"a\\\"b\\\\c\\/d\\n\\t\"", s) && s == "a\"b\\c/d\n\t");
+    CHECK(readText("\"\\u00e9\"", s) && s == "\xc3\xa9");
+    CHECK(readText("\"\\ud83d\\ude00\"", s) && s == "\xf0\x9f\x98\x80");
+    CHECK(!readText("\"unterminated", s));
+    CHECK(!readText("\"bad \\x escape\"", s));
+    CHECK(!readText("\"raw\ncontrol\"", s));
+
+    // Writer and reader round trip
+    JsonWriter writer;
+    std::string original("tab\tquote\"slash\\ctl\x1f utf8 \xc3\xa9");
+    writer.value(original);
+    std::string text = written(writer);
+    CHECK(readText(text, s) && s == original);
+}
+
+static void testNesting() {
+    std::string text = "{\"a\":[1,{\"b\":[[],{}]},\"]}\"],\"c\":{\"d\":null}}";
+    JsonReader reader(text.data(), text.data() + text.length());
+    const char *b, *e;
+    CHECK(reader.skip(&b, &e) && std::string(b, e) == text);
+
+    const char *bad[] = { "[1,2}", "{\"a\":1]", "[[1]", "[tru]", "[nul]", "[1-2]", "{\"a\":01}" };
+    for(size_t n = 0; n < sizeof(bad) / sizeof(bad[0]); n++) {
+        std::string t(bad[n]);
+        JsonReader r(t.data(), t.data() + t.length());
+        CHECK(!r.skip());
+    }
+
+    std::vector<std::vector<int>> nested;
+    std::string arrays = "[[1,2],[],[3]]";
+    JsonReader r(arrays.data(), arrays.data() + arrays.length());
+    CHECK(MessageTraits<std::vector<std::vector<int>>>::read(r, nested));
+    CHECK(nested.size() == 3 && nested[0].size() == 2 && nested[1].empty() && nested[2][0] == 3);
+}
+
+static void testEnvelope() {
+    std::string type, data;
+    CHECK(scanEnvelope("{\"type\":\"t\",\"data\":{\"x\":[1,2]}}", type, data) && type == "t" && data == "{\"x\":[1,2]}");
+    CHECK(scanEnvelope(" { \"data\" : \"s\" , \"type\" : \"u\\\"v\" } ", type, data) && type == "u\"v" && data == "\"s\"");
+    CHECK(scanEnvelope("{\"type\":\"t\",\"extra\":[{}],\"data\":-1.5e3}", type, data) && data == "-1.5e3");
+    CHECK(scanEnvelope("{\"type\":\"t\"}", type, data) && data == "null");
+    CHECK(!scanEnvelope("{\"data\":1}", type, data));
+    CHECK(!scanEnvelope("{\"type\":\"d\",\"data\":tru}", type, data));
+    CHECK(!scanEnvelope("{\"type\":\"d\",\"data\":[1,2}", type, data));
+    CHECK(!scanEnvelope("{\"type\":1,\"data\":1}", type, data));
+    CHECK(!scanEnvelope("[\"type\",\"t\"]", type, data));
+    CHECK(!scanEnvelope("", type, data));
+
+    // Passes the scan, fails the full parse: json() reports once and yields null
+    std::string text = "{\"type\":\"d\",\"data\":[1 2]}";
+    NullSink sink;
+    MessageFrame frame(text.data(), text.data() + text.length(), &sink);
+    std::string err_text;
+    CHECK(frame.decodeEnvelope(err_text));
+    CHECK(!frame.parseJson());
+    CHECK(!frame.parseJson());
+    CHECK(sink.errors == 1);
+    CHECK(frame.json().isNull());
+}
+
+/**
+ * Numbers must keep the JSON '.' under a locale with a comma decimal point
+ */
+static void testLocale() {
+    static const char *const locales[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "ru_RU.UTF-8", "ru_RU.utf8"
+    };
+    const char *override_locale = getenv("JSON_STREAM_TEST_LOCALE");
+    const char *selected = nullptr;
+    if(override_locale && setlocale(LC_NUMERIC, override_locale)) {
+        selected = override_locale;
+    } else {
+        for(const char *name : locales) {
+            if(setlocale(LC_NUMERIC, name)) {
+                selected = name;
+                break;
+            }
+        }
+    }
+    if(!selected || localeconv()->decimal_point[0] == '.') {
+        setlocale(LC_NUMERIC, "C");
+        printf("testLocale: no comma decimal point locale installed, skipped\n");
+        return;
+    }
+
+    JsonWriter writer;
+    writer.beginArray();
+    writer.value(1.5);
+    writer.value(-0.25);
+    writer.value(1e300);
+    writer.endArray();
+    CHECK(written(writer) == "[1.5,-0.25,1.0000000000000001e+300]");
+
+    double d = 0;
+    CHECK(readText("1.5", d) && d == 1.5);
+    CHECK(readText("-2.5e-3", d) && d == -2.5e-3);
+    long long ll = 0;
+    CHECK(readText("2.0e3", ll) && ll == 2000);
+
+    setlocale(LC_NUMERIC, "C");
+}
+
+int main() {
+    testWriter();
+    testIntegers();
+    testNumberGrammar();
+    testStrings();
+    testNesting();
+    testEnvelope();
+    testLocale();
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
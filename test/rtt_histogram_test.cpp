@@ -0,0 +1,100 @@
+/**
+ * RttHistogram buckets and nearest-rank percentiles
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "utils/rtt_histogram.h"
+
+using jcu::node_ipc::utils::RttHistogram;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+static uint64_t bucketOf(uint64_t value) {
+    RttHistogram histogram(1);
+    histogram.add(value);
+    return histogram.percentile(0.5);
+}
+
+static void testPercentile() {
+    RttHistogram histogram;
+    histogram.add(200);
+    histogram.add(300);
+    histogram.add(400);
+    histogram.add(5000);
+
+    // ceil(0.99 * 4) = 4th sample: the outlier, not the 400 bucket
+    CHECK(histogram.percentile(0.99) == 5119);
+    CHECK(histogram.percentile(1.0) == 5119);
+    CHECK(histogram.percentile(0.75) == 415);
+    CHECK(histogram.percentile(0.5) == 319);
+    CHECK(histogram.percentile(0.25) == 207);
+    CHECK(histogram.percentile(0.0) == 207);
+    CHECK(histogram.min() == 200);
+    CHECK(histogram.max() == 5000);
+    CHECK(histogram.mean() == 1475.0);
+
+    RttHistogram empty;
+    CHECK(empty.percentile(0.99) == 0);
+}
+
+static void testBuckets() {
+    // Exact below 16
+    CHECK(bucketOf(0) == 0);
+    CHECK(bucketOf(1) == 1);
+    CHECK(bucketOf(15) == 15);
+    // Then 8 sub-buckets per power of two
+    CHECK(bucketOf(16) == 17);
+    CHECK(bucketOf(17) == 17);
+    CHECK(bucketOf(18) == 19);
+    CHECK(bucketOf(31) == 31);
+    CHECK(bucketOf(32) == 35);
+    CHECK(bucketOf(35) == 35);
+    CHECK(bucketOf(36) == 39);
+    CHECK(bucketOf(4607) == 4607);
+    CHECK(bucketOf(4608) == 5119);
+    CHECK(bucketOf(UINT64_MAX) == UINT64_MAX);
+
+    for(uint64_t value = 16; value < ((uint64_t)1 << 40); value = value * 3 / 2 + 1) {
+        uint64_t upper = bucketOf(value);
+        CHECK(upper >= value);
+        CHECK(upper - value <= value / 8);
+    }
+}
+
+static void testWindow() {
+    RttHistogram histogram(4);
+    histogram.add(5000);
+    for(int i = 0; i < 4; i++) {
+        histogram.add(100);
+    }
+    // The outlier has left the window
+    CHECK(histogram.count() == 4);
+    CHECK(histogram.max() == 100);
+    CHECK(histogram.percentile(0.99) == 103);
+    CHECK(histogram.last() == 100);
+
+    histogram.clear();
+    CHECK(histogram.count() == 0);
+    CHECK(histogram.percentile(0.5) == 0);
+}
+
+int main() {
+    testPercentile();
+    testBuckets();
+    testWindow();
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,201 @@
+/**
+ * WorkerPool strands, stealing, saturation and shutdown
+ */
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "utils/worker_pool.h"
+
+using jcu::node_ipc::utils::WorkerPool;
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+        if(!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while(0)
+
+/**
+ * Closed until open(); tasks block on it to keep workers busy
+ */
+class Gate {
+public:
+    Gate() : open_(false) {}
+
+    void open() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        open_ = true;
+        cv_.notify_all();
+    }
+    bool wait(int timeout_ms = 10000) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() -> bool {
+            return open_;
+        });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool open_;
+};
+
+static bool waitUntil(const std::atomic<int>& value, int expected, int timeout_ms = 10000) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while(value.load() != expected) {
+        if(std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static void testOrdering() {
+    const int key_count = 16;
+    const int task_count = 20000;
+    std::mutex mutex;
+    std::map<std::string, std::vector<int>> seen;
+    std::vector<std::atomic<int>> running(key_count);
+    std::atomic<int> overlaps(0);
+    for(auto& r : running)
+        r = 0;
+
+    {
+        WorkerPool pool(4, 0);
+        for(int i = 0; i < task_count; i++) {
+            int k = i % key_count;
+            std::string key = "k" + std::to_string(k);
+            pool.submit(key, [&, key, k, i]() -> void {
+                if(running[k]++ != 0)
+                    overlaps++;
+                // Uneven work so that idle workers steal strands from busy ones
+                if(k == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    seen[key].push_back(i);
+                }
+                running[k]--;
+            });
+        }
+        pool.waitIdle();
+        CHECK(pool.pending() == 0);
+    }
+
+    size_t total = 0;
+    for(auto it = seen.begin(); it != seen.end(); it++) {
+        total += it->second.size();
+        for(size_t i = 1; i < it->second.size(); i++) {
+            CHECK(it->second[i] > it->second[i - 1]);
+        }
+    }
+    CHECK(total == (size_t)task_count);
+    CHECK(overlaps == 0);
+}
+
+static void testStealing() {
+    const size_t threads = 2;
+    WorkerPool pool(threads, 0);
+
+    // Two keys with the same home worker
+    std::string blocker = "blocker";
+    size_t home = std::hash<std::string>()(blocker) % threads;
+    std::string other;
+    for(int i = 0; other.empty(); i++) {
+        std::string key = "other" + std::to_string(i);
+        if(std::hash<std::string>()(key) % threads == home)
+            other = key;
+    }
+
+    Gate gate;
+    std::atomic<int> done(0);
+    pool.submit(blocker, [&]() -> void {
+        gate.wait();
+    });
+    for(int i = 0; i < 10; i++) {
+        pool.submit(other, [&]() -> void {
+            done++;
+        });
+    }
+    // Only the other worker can run them while the home worker is blocked
+    CHECK(waitUntil(done, 10));
+    gate.open();
+    pool.waitIdle();
+}
+
+static void testSpace() {
+    std::atomic<int> space_calls(0);
+    std::atomic<bool> space_on_worker(false);
+    std::atomic<int> done(0);
+    Gate gate;
+
+    WorkerPool pool(2, 8, [&]() -> void {
+        space_on_worker = WorkerPool::isWorkerThread();
+        space_calls++;
+    });
+
+    for(int i = 0; i < 7; i++) {
+        pool.submit("k" + std::to_string(i % 3), [&]() -> void {
+            gate.wait();
+            done++;
+        });
+    }
+    CHECK(!pool.saturated());
+    pool.submit("k0", [&]() -> void {
+        gate.wait();
+        done++;
+    });
+    CHECK(pool.saturated());
+    CHECK(space_calls == 0);
+
+    gate.open();
+    CHECK(waitUntil(space_calls, 1));
+    pool.waitIdle();
+    CHECK(done == 8);
+    CHECK(space_calls == 1);
+    CHECK(space_on_worker);
+    CHECK(!pool.saturated());
+
+    // waitForSpace returns once below the limit
+    pool.waitForSpace();
+}
+
+static void testDrainOnDestroy() {
+    std::atomic<int> done(0);
+    const int task_count = 1000;
+    {
+        WorkerPool pool(3, 0);
+        for(int i = 0; i < task_count; i++) {
+            pool.submit("k" + std::to_string(i % 5), [&]() -> void {
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+                done++;
+            });
+        }
+    }
+    // The destructor runs every queued task before joining
+    CHECK(done == task_count);
+}
+
+int main() {
+    testOrdering();
+    testStealing();
+    testSpace();
+    testDrainOnDestroy();
+    if(failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}